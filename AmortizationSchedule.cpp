@@ -0,0 +1,110 @@
+#include "AmortizationSchedule.h"
+#include "Calculator.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+
+// Advances one period from the balance at its start. Balances within errorThreshold of zero are reported as zero,
+// and the last period lands exactly on finalBalance (-fv) instead of carrying the rounding of every earlier period.
+static inline void amortizationStep(double startBalance, double rate, double payment, double errorThreshold, bool last, double finalBalance, AmortizationRow& row)
+{
+    row.interest = startBalance * rate;
+    row.principal = -payment - row.interest;
+    const double balance = startBalance - row.principal; // startBalance * (1 + i) + payment
+    row.balance = last ? finalBalance : (std::fabs(balance) < errorThreshold) ? 0 : balance;
+}
+
+AmortizationSchedule::AmortizationSchedule(const Calculator& calculator, double pv, double i, int n, double fv)
+    : pv(pv), fv(fv), rate(i), periods(n), payment(calculator.calculatePMT(pv, fv, i, n)),
+      errorThreshold(calculator.getSettings().errorThreshold)
+{
+}
+
+/*------------
+Lazy Iteration
+-------------*/
+AmortizationSchedule::Iterator::Iterator(const AmortizationSchedule& schedule, int period)
+    : rate(schedule.rate), errorThreshold(schedule.errorThreshold), finalBalance(0 - schedule.fv), periods(schedule.periods)
+{
+    row.period = period;
+    row.payment = schedule.payment;
+    if (period <= periods) amortizationStep(schedule.pv, rate, row.payment, errorThreshold, period == periods, finalBalance, row);
+}
+
+AmortizationSchedule::Iterator& AmortizationSchedule::Iterator::operator++()
+{
+    row.period++;
+    if (row.period <= periods) amortizationStep(row.balance, rate, row.payment, errorThreshold, row.period == periods, finalBalance, row);
+    return *this;
+}
+
+AmortizationSchedule::Iterator AmortizationSchedule::Iterator::operator++(int)
+{
+    Iterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+/*------------
+Bulk Generation
+-------------*/
+size_t AmortizationSchedule::rowOffsets(const int* n, size_t count, size_t* offsets)
+{
+    size_t total = 0;
+    for (size_t loan = 0; loan < count; loan++)
+    {
+        offsets[loan] = total;
+        if (n[loan] > 0) total += static_cast<size_t>(n[loan]);
+    }
+    offsets[count] = total;
+    return total;
+}
+
+void AmortizationSchedule::generate(const Calculator& calculator, const double* pv, const double* i, const int* n, const double* fv,
+                                    size_t count, const size_t* offsets, const Columns& out, unsigned threads)
+{
+    const double errorThreshold = calculator.getSettings().errorThreshold;
+
+    auto generateLoans = [&](size_t begin, size_t end)
+    {
+        // Payments for a block of loans at a time through the batch solver, staged on the stack
+        const size_t blockSize = 256;
+        double periods[blockSize];
+        double futureValues[blockSize];
+        double payments[blockSize];
+        for (size_t start = begin; start < end; start += blockSize)
+        {
+            const size_t loans = (end - start < blockSize) ? end - start : blockSize;
+            for (size_t loan = 0; loan < loans; loan++)
+            {
+                periods[loan] = n[start + loan];
+                futureValues[loan] = (fv != nullptr) ? fv[start + loan] : 0;
+            }
+            calculator.calculatePMTBatch(pv + start, futureValues, i + start, periods, payments, loans);
+
+            for (size_t loan = 0; loan < loans; loan++)
+            {
+                const size_t first = offsets[start + loan];
+                const int rows = n[start + loan];
+                const double rate = i[start + loan];
+                const double payment = payments[loan];
+                const double finalBalance = std::isnan(payment) ? payment : 0 - futureValues[loan];
+                AmortizationRow row;
+                double balance = std::isnan(payment) ? payment : pv[start + loan];
+                for (int period = 0; period < rows; period++)
+                {
+                    amortizationStep(balance, rate, payment, errorThreshold, period + 1 == rows, finalBalance, row);
+                    balance = row.balance;
+                    const size_t index = first + period;
+                    if (out.payment != nullptr) out.payment[index] = payment;
+                    if (out.interest != nullptr) out.interest[index] = row.interest;
+                    if (out.principal != nullptr) out.principal[index] = row.principal;
+                    if (out.balance != nullptr) out.balance[index] = row.balance;
+                }
+            }
+        }
+    };
+
+    if (threads == 1) generateLoans(0, count);
+    else ThreadPool::shared().parallelFor(count, 64, generateLoans);
+}
@@ -0,0 +1,89 @@
+#ifndef AMORTIZATION_SCHEDULE_H
+#define AMORTIZATION_SCHEDULE_H
+
+#include <cstddef>
+#include <iterator>
+
+class Calculator;
+
+// One period of a schedule. Amounts follow the TVM sign convention: with a positive pv the payment is negative,
+// while interest, principal and balance carry the sign of pv (principal is the amount the balance goes down by).
+struct AmortizationRow
+{
+    int period;       // 1 .. n
+    double payment;   // calculatePMT(pv, fv, i, n), the same every period
+    double interest;  // Balance at the start of the period times i
+    double principal; // -payment - interest
+    double balance;   // Balance after the payment; exactly -fv after the last period, which absorbs rounding
+};
+
+// Lazy amortization schedule: the payment comes from calculatePMT once, then each period is derived from the
+// previous balance as the range is walked, so a schedule of any length costs one row of state and no allocation.
+//
+//     for (const AmortizationRow& row : AmortizationSchedule(calc, 200000, 0.005, 360)) ...
+class AmortizationSchedule
+{
+public:
+    // Loan of pv at rate i per period over n periods leaving fv (0 pays the loan off). Throws std::invalid_argument
+    // for the inputs calculatePMT rejects.
+    AmortizationSchedule(const Calculator& calculator, double pv, double i, int n, double fv = 0);
+
+    class Iterator
+    {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef AmortizationRow value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const AmortizationRow* pointer;
+        typedef const AmortizationRow& reference;
+
+        reference operator*() const { return row; }
+        pointer operator->() const { return &row; }
+        Iterator& operator++();
+        Iterator operator++(int);
+        bool operator==(const Iterator& other) const { return row.period == other.row.period; }
+        bool operator!=(const Iterator& other) const { return row.period != other.row.period; }
+
+    private:
+        friend class AmortizationSchedule;
+        Iterator(const AmortizationSchedule& schedule, int period);
+
+        AmortizationRow row;
+        double rate;
+        double errorThreshold;
+        double finalBalance;
+        int periods;
+    };
+
+    Iterator begin() const { return Iterator(*this, 1); }
+    Iterator end() const { return Iterator(*this, periods + 1); }
+    int size() const { return periods; }
+    double getPayment() const { return payment; }
+
+    // Bulk mode: writes the schedules of count loans into caller-owned columns, loan k's n[k] rows starting at row
+    // offsets[k] (see rowOffsets). fv may be null when every loan is paid off; columns left null are skipped.
+    // Payments come from calculatePMTBatch; loans it rejects get NaN rows. threads != 1 spreads the loans over the
+    // shared ThreadPool.
+    struct Columns
+    {
+        double* payment;
+        double* interest;
+        double* principal;
+        double* balance;
+    };
+    static void generate(const Calculator& calculator, const double* pv, const double* i, const int* n, const double* fv,
+                         size_t count, const size_t* offsets, const Columns& out, unsigned threads = 1);
+    // Fills offsets[0 .. count] with each loan's first row and the total, which it also returns, so the caller can
+    // size the columns. Loans with n <= 0 have no rows.
+    static size_t rowOffsets(const int* n, size_t count, size_t* offsets);
+
+private:
+    double pv;
+    double fv;
+    double rate;
+    int periods;
+    double payment;
+    double errorThreshold;
+};
+
+#endif
@@ -1,129 +1,440 @@
 #include "Calculator.h"
+#include "ThreadPool.h"
+#include "NativeCompiler.h"
+#include "MathKernels.h"
+#include "ConstMath.h"
 
 #include <string>
 #include <vector>
 #include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <stdexcept>
 #include <cmath>
-#include <fstream> 
+#include <istream>
 
 Calculator::Calculator(bool radianMode, bool saveHistory, int taylorTerms, double initialGuessInterest, double initialGuessPeriods, double errorThreshold)
+    : settingsStore(Settings{radianMode, saveHistory, taylorTerms, initialGuessInterest, initialGuessPeriods, errorThreshold})
 {
-    settingRadianMode = radianMode;
-    settingSaveHistory = saveHistory;
-    settingTaylorTerms = taylorTerms;
-    settingInitialGuessInterest = initialGuessInterest;
-    settingInitialGuessPeriods = initialGuessPeriods;
-    settingErrorThreshold = errorThreshold;
+    // The writer only opens the file and starts its thread on the first saved record
+    historyWriter = std::make_shared<HistoryWriter>("calculation_history.txt");
+#ifdef CALCULATOR_METRICS
+    metrics = std::make_shared<Metrics>();
+#endif
+}
+
+/*-------
+Settings
+--------*/
+Calculator::SettingsStore::SettingsStore(const Settings& initial)
+{
+    publish(initial);
+}
+
+Calculator::SettingsStore::SettingsStore(const SettingsStore& other)
+    : current(other.load()) // Snapshots are immutable, so the two stores can share the current one
+{
+}
+
+Calculator::SettingsStore& Calculator::SettingsStore::operator=(const SettingsStore& other)
+{
+    const std::shared_ptr<const Settings> settings = other.load(); // Loaded first, other may be this store
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::atomic_store(&current, settings);
+    return *this;
+}
+
+void Calculator::SettingsStore::update(const std::function<void(Settings&)>& change)
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+    Settings settings = *load();
+    change(settings);
+    publish(settings);
+}
+
+void Calculator::SettingsStore::publish(const Settings& settings)
+{
+    std::atomic_store(&current, std::make_shared<const Settings>(settings));
+}
+
+Calculator::Settings Calculator::getSettings() const
+{
+    return *settingsStore.load();
+}
+
+void Calculator::updateSettings(const std::function<void(Settings&)>& change)
+{
+    settingsStore.update(change);
+}
+
+void Calculator::setRadianMode(bool radianMode)
+{
+    updateSettings([=](Settings& settings) { settings.radianMode = radianMode; });
+}
+
+void Calculator::setSaveHistory(bool saveHistory)
+{
+    updateSettings([=](Settings& settings) { settings.saveHistory = saveHistory; });
+}
+
+void Calculator::setTaylorTerms(int taylorTerms)
+{
+    updateSettings([=](Settings& settings) { settings.taylorTerms = taylorTerms; });
+}
+
+void Calculator::setInitialGuessInterest(double initialGuessInterest)
+{
+    updateSettings([=](Settings& settings) { settings.initialGuessInterest = initialGuessInterest; });
+}
+
+void Calculator::setInitialGuessPeriods(double initialGuessPeriods)
+{
+    updateSettings([=](Settings& settings) { settings.initialGuessPeriods = initialGuessPeriods; });
+}
+
+void Calculator::setErrorThreshold(double errorThreshold)
+{
+    updateSettings([=](Settings& settings) { settings.errorThreshold = errorThreshold; });
 }
 
 /*---------------
 Tokenize Function
 -----------------*/
-std::vector<Calculator::Token> Calculator::tokenize(const std::string& inputExpression) const
+std::vector<Calculator::Token> Calculator::tokenize(const std::string& inputExpression, const std::vector<std::string>& variableNames) const
 {
     std::vector<Token> tokens; // Stores the tokens
-    std::string currentToken; // For multi digit or letter tokens 
-    bool expectNumber = true; // Finite state for detecting unary minus vs. binary subtraction
-    
-    for (int index = 0; index < inputExpression.length(); index++)
-    {
-        currentToken.clear();
-        char character = inputExpression[index];
-        
-        // Skip white space
-        if (std::isspace(character)) continue;
+    tokenize(inputExpression, variableNames, tokens);
+    return tokens;
+}
 
-        // Digits: use currentToken to build multi digit token
-        if (std::isdigit(character) || character == '.')
-        {
-            while (index < inputExpression.length() && (std::isdigit(inputExpression[index]) || inputExpression[index] == '.')) // While expression[index] is still a digit or decimal append to currentToken and increment index
-            {
-                currentToken += inputExpression[index++];
-                // Check if currentToken contains multiple '.'
-                if (currentToken.find('.') != currentToken.rfind('.'))
-                {
-                    throw std::invalid_argument("Invalid number format: multiple decimal points in " + currentToken);
-                }
-            }
-            index--; // undo last while loop increment because for loop will increment
+void Calculator::tokenize(const std::string& inputExpression, const std::vector<std::string>& variableNames, std::vector<Calculator::Token>& tokens) const
+{
+    EvalOutcome error;
+    if (!tokenize(inputExpression, variableNames, tokens, error)) throwEvalError(error, inputExpression);
+}
+
+// Reports a parse error at [position, position + length) of the input
+static bool parseError(Calculator::EvalOutcome& error, Calculator::EvalStatus status, size_t position, size_t length)
+{
+    error.value = std::nan("");
+    error.status = status;
+    error.position = position;
+    error.length = length;
+    return false;
+}
 
-            tokens.push_back(Token{NUMBER, currentToken});
-            expectNumber = false; // After a number, expect an operator
+// Scans the literal at index: digits with at most one decimal point, then an optional exponent (1e-6, 2.5E+3), and
+// parses it with from_chars. index ends on the literal's last character.
+static bool scanNumber(const std::string& inputExpression, size_t& index, double& number, Calculator::EvalOutcome& error)
+{
+    const size_t start = index;
+    const size_t length = inputExpression.length();
+    const char* text = inputExpression.data();
+    bool decimalPoint = false;
+    while (index < length && ((text[index] >= '0' && text[index] <= '9') || text[index] == '.'))
+    {
+        if (text[index] == '.')
+        {
+            if (decimalPoint) return parseError(error, Calculator::EVAL_MULTIPLE_DECIMAL_POINTS, start, index + 1 - start);
+            decimalPoint = true;
         }
+        index++;
+    }
+    if (index < length && (text[index] == 'e' || text[index] == 'E'))
+    {
+        size_t exponent = index + 1;
+        if (exponent < length && (text[exponent] == '+' || text[exponent] == '-')) exponent++;
+        const size_t digits = exponent;
+        while (exponent < length && text[exponent] >= '0' && text[exponent] <= '9') exponent++;
+        if (exponent == digits) return parseError(error, Calculator::EVAL_INVALID_NUMBER, start, exponent - start); // "1e", "2e+"
+        index = exponent;
+    }
+
+    const std::from_chars_result parsed = std::from_chars(text + start, text + index, number);
+    if (parsed.ptr != text + index || (parsed.ec != std::errc() && parsed.ec != std::errc::result_out_of_range))
+    {
+        return parseError(error, Calculator::EVAL_INVALID_NUMBER, start, index - start);
+    }
+    if (parsed.ec == std::errc::result_out_of_range)
+    {
+        number = std::strtod(inputExpression.substr(start, index - start).c_str(), nullptr); // Overflow to inf, underflow to 0
+    }
+    index--; // Leave index on the last character, the caller's loop steps past it
+    return true;
+}
 
-        // Alphabetic: try to match to function or pi after using currentToken to build word
-        else if(std::isalpha(character))
+// True when [word, word + length) spells text
+static bool wordIs(const char* word, size_t length, const char* text)
+{
+    return std::strlen(text) == length && std::memcmp(word, text, length) == 0;
+}
+
+const Calculator::FunctionInfo Calculator::functions[] =
+{
+    {"sin", OP_SIN, 1, 1}, {"cos", OP_COS, 1, 1}, {"tan", OP_TAN, 1, 1},
+    {"asin", OP_ASIN, 1, 1}, {"acos", OP_ACOS, 1, 1}, {"atan", OP_ATAN, 1, 1},
+    {"sinh", OP_SINH, 1, 1}, {"cosh", OP_COSH, 1, 1}, {"tanh", OP_TANH, 1, 1},
+    {"exp", OP_EXP, 1, 1}, {"ln", OP_LN, 1, 1}, {"log", OP_LOG, 1, 1}, {"sqrt", OP_SQRT, 1, 1}, {"abs", OP_ABS, 1, 1},
+    {"pow", OP_POWER, 2, 2}, {"min", OP_MIN, 1, 0}, {"max", OP_MAX, 1, 0},
+    {nullptr, OP_NUMBER, 0, 0}
+};
+
+const Calculator::FunctionInfo* Calculator::findFunction(const char* word, size_t length)
+{
+    for (const FunctionInfo* function = functions; function->name != nullptr; function++)
+    {
+        if (wordIs(word, length, function->name)) return function;
+    }
+    return nullptr;
+}
+
+// Fixed capacity stack held in place; only nesting deeper than Capacity spills to the heap
+template <class Item, size_t Capacity>
+class InlineStack
+{
+public:
+    InlineStack() : count(0) {}
+
+    bool empty() const { return count == 0; }
+    Item& back() { return (count <= Capacity) ? items[count - 1] : overflow.back(); }
+    void push(Item item)
+    {
+        if (count < Capacity) items[count] = item;
+        else overflow.push_back(item);
+        count++;
+    }
+    void pop()
+    {
+        count--;
+        if (count >= Capacity) overflow.pop_back();
+    }
+
+private:
+    Item items[Capacity];
+    size_t count;
+    std::vector<Item> overflow;
+};
+
+struct Calculator::ParseState
+{
+    // One open parenthesis
+    struct Group
+    {
+        const FunctionInfo* function; // Function whose argument list it opened, null for grouping parentheses
+        size_t namePosition;          // Where that function's name starts, argument count errors point there
+        int arguments;                // Commas seen so far + 1
+    };
+
+    ParseState() : expectNumber(true), function(nullptr), functionPosition(0) {}
+
+    bool expectNumber;               // Finite state for detecting unary minus vs. binary subtraction
+    const FunctionInfo* function;    // Function read by the previous token, a '(' now opens its argument list
+    size_t functionPosition;
+    InlineStack<Group, 32> groups;   // Parentheses not closed yet
+};
+
+// Reads the token starting at index (not whitespace) and checks the grammar as it goes: operands and operators
+// alternate, parentheses balance and every function gets an argument count it takes. Every token sequence it
+// accepts therefore converts to a valid RPN program, and errors carry the position where they occur. index ends
+// on the token's last character.
+bool Calculator::nextToken(const std::string& inputExpression, const std::vector<std::string>& variableNames, size_t& index,
+                           ParseState& state, Calculator::Token& token, EvalOutcome& error) const
+{
+    const size_t tokenStart = index;
+    const char character = inputExpression[index];
+    const FunctionInfo* previousFunction = state.function;
+    state.function = nullptr;
+    // Functions with more than one argument are only written as calls: pow(2, x), not pow 2
+    if (previousFunction != nullptr && previousFunction->maxArguments != 1 && character != '(')
+    {
+        return parseError(error, EVAL_MISSING_LEFT_PAREN, tokenStart, 1);
+    }
+
+    // Numbers
+    if ((character >= '0' && character <= '9') || character == '.')
+    {
+        if (!state.expectNumber) return parseError(error, EVAL_EXTRA_OPERAND, tokenStart, 1);
+        double number;
+        if (!scanNumber(inputExpression, index, number, error)) return false;
+        token = Token{NUMBER, OP_NUMBER, number};
+        state.expectNumber = false; // After a number, expect an operator
+    }
+
+    // Alphabetic: match the word to a function, pi or a variable
+    else if (std::isalpha(static_cast<unsigned char>(character)) || character == '_')
+    {
+        while (index < inputExpression.length() && (std::isalnum(static_cast<unsigned char>(inputExpression[index])) || inputExpression[index] == '_')) index++;
+        const char* word = inputExpression.data() + tokenStart;
+        const size_t length = index - tokenStart;
+        index--; // Leave index on the last character, the caller's loop steps past it
+        if (!state.expectNumber) return parseError(error, EVAL_EXTRA_OPERAND, tokenStart, length);
+
+        if (wordIs(word, length, "pi") || wordIs(word, length, "Pi") || wordIs(word, length, "PI"))
         {
-            while (index < inputExpression.length() && std::isalpha(inputExpression[index]))
-            {
-                currentToken += inputExpression[index++];
-            }
-            index--; // undo last while loop increment because for loop will increment
-            // Match word to known function or pi
-            if (currentToken == "pi" || currentToken == "Pi" || currentToken == "PI")
-            {
-                tokens.push_back(Token{NUMBER, "3.141592653589793"});
-                expectNumber = false; // After a number, expect an operator
-            }
-            else if (currentToken == "sin" || currentToken == "cos" || currentToken == "tan")
-            {
-                tokens.push_back(Token{FUNCTION, currentToken});
-                expectNumber = true; // After a Function, expect a number
-            }
-            else
-            {
-                throw std::invalid_argument("Unrecognized function: " + currentToken);
-            }
+            token = Token{NUMBER, OP_NUMBER, 3.141592653589793};
+            state.expectNumber = false; // After a number, expect an operator
         }
-        // Operators
-        else if (character == '^' || character == '*' || character == '/' || character == '+' || character == '-')
+        else if (const FunctionInfo* function = findFunction(word, length))
         {
-            if (character == '-' && expectNumber) // if expecting a number and instead get a -, append unary minus
-            {
-                tokens.push_back(Token{OPERATOR, "u-"});
-            }
-            else
-            {
-                tokens.push_back(Token{OPERATOR, std::string(1, character)});
-            }
-            expectNumber = true; // After an Operator, expect a number
+            token = Token{FUNCTION, function->opcode, 0, 1};
+            state.function = function;
+            state.functionPosition = tokenStart;
+            state.expectNumber = true; // After a Function, expect a number
         }
-        // Left Parenthesis
-        else if (character == '(')
+        else
         {
-            tokens.push_back(Token{LEFT_PAREN, "("});
-            expectNumber = true; // After left parenthesis, expect a number
+            // Variables resolve to their slot here so evaluation only indexes an array
+            const int variableCount = static_cast<int>(variableNames.size());
+            int slot = 0;
+            while (slot < variableCount && !(variableNames[slot].length() == length && variableNames[slot].compare(0, length, word, length) == 0)) slot++;
+            if (slot == variableCount) return parseError(error, EVAL_UNKNOWN_NAME, tokenStart, length);
+            token = Token{NUMBER, OP_VARIABLE, 0, slot};
+            state.expectNumber = false; // A variable is a value, expect an operator
         }
-        // Right Parenthesis
-        else if (character == ')')
+    }
+    // Operators
+    else if (character == '^' || character == '*' || character == '/' || character == '+' || character == '-')
+    {
+        if (character == '-' && state.expectNumber) // if expecting a number and instead get a -, it is a unary minus
         {
-            tokens.push_back(Token{RIGHT_PAREN, ")"});
-            expectNumber = false; // After right parenthesis, expect an operator
+            token = Token{OPERATOR, OP_NEGATE};
         }
         else
         {
-            throw std::invalid_argument(std::string("Unrecognized character: ") + character);
+            if (state.expectNumber) return parseError(error, EVAL_MISSING_OPERAND, tokenStart, 1);
+            OpCode operation = (character == '^') ? OP_POWER :
+                               (character == '*') ? OP_MULTIPLY :
+                               (character == '/') ? OP_DIVIDE :
+                               (character == '+') ? OP_ADD : OP_SUBTRACT;
+            token = Token{OPERATOR, operation};
         }
+        state.expectNumber = true; // After an Operator, expect a number
     }
-    return tokens;
+    // Left Parenthesis
+    else if (character == '(')
+    {
+        if (!state.expectNumber) return parseError(error, EVAL_EXTRA_OPERAND, tokenStart, 1);
+        token = Token{LEFT_PAREN, OP_LEFT_PAREN};
+        state.groups.push(ParseState::Group{previousFunction, state.functionPosition, 1});
+        state.expectNumber = true; // After left parenthesis, expect a number
+    }
+    // Right Parenthesis: closes a group, checking a function's argument count
+    else if (character == ')')
+    {
+        if (state.groups.empty()) return parseError(error, EVAL_MISSING_LEFT_PAREN, tokenStart, 1);
+        if (state.expectNumber) return parseError(error, EVAL_MISSING_OPERAND, tokenStart, 1);
+        const ParseState::Group group = state.groups.back();
+        if (group.function != nullptr && group.arguments < group.function->minArguments)
+        {
+            return parseError(error, EVAL_ARGUMENT_COUNT, group.namePosition, std::strlen(group.function->name));
+        }
+        token = Token{RIGHT_PAREN, OP_RIGHT_PAREN, 0, group.arguments};
+        state.groups.pop();
+        state.expectNumber = false; // After right parenthesis, expect an operator
+    }
+    // Comma: separates the arguments of a function call
+    else if (character == ',')
+    {
+        if (state.expectNumber) return parseError(error, EVAL_MISSING_OPERAND, tokenStart, 1);
+        if (state.groups.empty() || state.groups.back().function == nullptr) return parseError(error, EVAL_EXTRA_OPERAND, tokenStart, 1);
+        ParseState::Group& group = state.groups.back();
+        if (group.function->maxArguments != 0 && group.arguments == group.function->maxArguments)
+        {
+            return parseError(error, EVAL_ARGUMENT_COUNT, group.namePosition, std::strlen(group.function->name));
+        }
+        group.arguments++;
+        token = Token{COMMA, OP_COMMA};
+        state.expectNumber = true; // After a comma, expect the next argument
+    }
+    else
+    {
+        return parseError(error, EVAL_UNKNOWN_CHARACTER, tokenStart, 1);
+    }
+    return true;
+}
+
+// The expression must end on a value with every parenthesis closed; both errors point at the end of the input
+static bool finishParse(const std::string& inputExpression, bool expectNumber, bool parenthesesOpen, Calculator::EvalOutcome& error)
+{
+    if (expectNumber) return parseError(error, Calculator::EVAL_MISSING_OPERAND, inputExpression.length(), 0);
+    if (parenthesesOpen) return parseError(error, Calculator::EVAL_MISSING_RIGHT_PAREN, inputExpression.length(), 0);
+    return true;
+}
+
+bool Calculator::tokenize(const std::string& inputExpression, const std::vector<std::string>& variableNames, std::vector<Calculator::Token>& tokens, EvalOutcome& error) const
+{
+    tokens.clear();
+    ParseState state;
+    Token token{NUMBER, OP_NUMBER};
+    for (size_t index = 0; index < inputExpression.length(); index++)
+    {
+        if (std::isspace(static_cast<unsigned char>(inputExpression[index]))) continue;
+        if (!nextToken(inputExpression, variableNames, index, state, token, error)) return false;
+        tokens.push_back(token);
+    }
+    return finishParse(inputExpression, state.expectNumber, !state.groups.empty(), error);
 }
 
 /*
 Additional Functions for Shunting Yard Algorithm
 */ 
-int Calculator::getPrecedence(const std::string& operation) const
+int Calculator::getPrecedence(OpCode operation) const
+{
+    switch (operation)
+    {
+        case OP_ADD:
+        case OP_SUBTRACT: return 1;
+        case OP_MULTIPLY:
+        case OP_DIVIDE: return 2;
+        case OP_POWER: return 3;
+        case OP_NEGATE: return 4;
+        default: return 0;
+    }
+}
+
+bool Calculator::isLeftAssociative(OpCode operation) const
 {
-    if (operation == "+" || operation == "-") return 1;
-    if (operation == "*" || operation == "/") return 2;
-    if (operation == "^") return 3;
-    if (operation == "u-") return 4;
-    return 0;     
+    return (operation != OP_POWER && operation != OP_NEGATE);
 }
 
-bool Calculator::isLeftAssociative(const std::string& operation) const
+// Same text as streaming the value with default formatting, without constructing a stream
+static std::string formatNumber(double value)
 {
-    return (operation != "^" && operation != "u-");
+    char text[32];
+    std::snprintf(text, sizeof(text), "%g", value);
+    return text;
+}
+
+std::string Calculator::tokenText(const Token& token, const std::vector<std::string>& variableNames) const
+{
+    if (token.type == FUNCTION)
+    {
+        // Functions print by name; min and max in the RPN program add their argument count, as in max[3]
+        const FunctionInfo* function = functions;
+        while (function->name != nullptr && function->opcode != token.opcode) function++;
+        if (function->maxArguments == 0 && token.slot != 1) return std::string(function->name) + "[" + std::to_string(token.slot) + "]";
+        return (function->name != nullptr) ? function->name : "";
+    }
+    switch (token.opcode)
+    {
+        case OP_NUMBER: return formatNumber(token.number);
+        case OP_VARIABLE: return variableNames[token.slot];
+        case OP_ADD: return "+";
+        case OP_SUBTRACT: return "-";
+        case OP_MULTIPLY: return "*";
+        case OP_DIVIDE: return "/";
+        case OP_POWER: return "^";
+        case OP_NEGATE: return "u-";
+        case OP_LEFT_PAREN: return "(";
+        case OP_RIGHT_PAREN: return ")";
+        case OP_COMMA: return ",";
+        default: break;
+    }
+    return "";
 }
 
 /*---------------------------------------------------------------
@@ -133,6 +444,14 @@ std::vector<Calculator::Token> Calculator::convertToRPN(const std::vector<Calcul
 {
     std::vector<Calculator::Token> outputStack;
     std::vector<Calculator::Token> operatorStack;
+    convertToRPN(tokenExpression, outputStack, operatorStack);
+    return outputStack;
+}
+
+void Calculator::convertToRPN(const std::vector<Calculator::Token>& tokenExpression, std::vector<Calculator::Token>& outputStack, std::vector<Calculator::Token>& operatorStack) const
+{
+    outputStack.clear();
+    operatorStack.clear();
 
     for (const Token& token : tokenExpression)
     {
@@ -146,12 +465,12 @@ std::vector<Calculator::Token> Calculator::convertToRPN(const std::vector<Calcul
         }
         else if (token.type == OPERATOR)
         {
-            std::string operator1 = token.value;
+            OpCode operator1 = token.opcode;
             while (!operatorStack.empty() && operatorStack.back().type != LEFT_PAREN &&
                     // for right associative operator 1: operatorStack operation is > precedence than operator 1
                     // or for left associative operator 1: operatorStack operation is == precedence to operator 1) 
-                  (getPrecedence(operatorStack.back().value) > getPrecedence(operator1) ||
-                  (getPrecedence(operatorStack.back().value) == getPrecedence(operator1) && isLeftAssociative(operator1))))
+                  (getPrecedence(operatorStack.back().opcode) > getPrecedence(operator1) ||
+                  (getPrecedence(operatorStack.back().opcode) == getPrecedence(operator1) && isLeftAssociative(operator1))))
             {
                 outputStack.push_back(operatorStack.back());
                 operatorStack.pop_back();
@@ -170,225 +489,1292 @@ std::vector<Calculator::Token> Calculator::convertToRPN(const std::vector<Calcul
                 outputStack.push_back(operatorStack.back());
                 operatorStack.pop_back();
             }
-            if (operatorStack.empty()) 
+            operatorStack.pop_back(); // discard left parenthesis, tokenize guarantees there is one
+            // A function applies to the parenthesized arguments that just closed, the parenthesis counted them
+            if (!operatorStack.empty() && operatorStack.back().type == FUNCTION)
             {
-                throw std::invalid_argument("Mismatched parenthesis, missing: '('");
+                const OpCode function = operatorStack.back().opcode;
+                outputStack.push_back((function == OP_POWER) ? Token{OPERATOR, OP_POWER} : Token{FUNCTION, function, 0, token.slot});
+                operatorStack.pop_back();
             }
-            operatorStack.pop_back(); // discard left parenthesis
         }
-        else
+        else if (token.type == COMMA)
         {
-            throw std::invalid_argument("Unknown Token Type for value: " + token.value); 
+            // The argument before the comma is complete: push its operators up to the call's left parenthesis
+            while (operatorStack.back().type != LEFT_PAREN)
+            {
+                outputStack.push_back(operatorStack.back());
+                operatorStack.pop_back();
+            }
         }
     }
-    // Empty the remaining operator evalStack
+    // Empty the remaining operator evalStack (tokenize guarantees every parenthesis was closed)
     while(!operatorStack.empty())
     {
-        if (operatorStack.back().type == LEFT_PAREN)
-        {
-            throw std::invalid_argument("Mismatched parenthesis, missing: ')'");
-        }
         outputStack.push_back(operatorStack.back());
         operatorStack.pop_back();
     }
-    return outputStack;
+}
+
+/*----------------------------------------------
+Fused Parser: tokenize + Shunting Yard in one pass
+-----------------------------------------------*/
+// Scans the input once, running each token through the same operator-stack rules as convertToRPN as soon as it is
+// read, so the RPN program comes out without a token list in between. The operator stack only holds the type and
+// opcode of each entry. maxDepth receives the deepest evaluation stack the program needs.
+bool Calculator::parseToRPN(const std::string& inputExpression, const std::vector<std::string>& variableNames, std::vector<Calculator::Token>& program,
+                            int& maxDepth, EvalOutcome& error) const
+{
+    struct PendingOperator
+    {
+        TokenType type;
+        OpCode opcode;
+    };
+    program.clear();
+    InlineStack<PendingOperator, 256> operatorStack;
+    ParseState state;
+    int depth = 0;
+    maxDepth = 0;
+
+    // Binary operators pop two operands and push one, functions pop their arguments; pow(a, b) becomes a ^ b
+    auto emitOperator = [&](const PendingOperator& operation, int arguments)
+    {
+        const bool function = (operation.type == FUNCTION && operation.opcode != OP_POWER);
+        program.push_back(function ? Token{FUNCTION, operation.opcode, 0, arguments} : Token{OPERATOR, operation.opcode});
+        depth -= function ? arguments - 1 : (operation.opcode == OP_NEGATE) ? 0 : 1;
+    };
+
+    Token token{NUMBER, OP_NUMBER};
+    for (size_t index = 0; index < inputExpression.length(); index++)
+    {
+        if (std::isspace(static_cast<unsigned char>(inputExpression[index]))) continue;
+        if (!nextToken(inputExpression, variableNames, index, state, token, error)) return false;
+
+        if (token.type == NUMBER)
+        {
+            program.push_back(token);
+            if (++depth > maxDepth) maxDepth = depth;
+        }
+        else if (token.type == FUNCTION || token.type == LEFT_PAREN)
+        {
+            operatorStack.push(PendingOperator{token.type, token.opcode});
+        }
+        else if (token.type == OPERATOR)
+        {
+            const int precedence = getPrecedence(token.opcode);
+            const bool leftAssociative = isLeftAssociative(token.opcode);
+            while (!operatorStack.empty() && operatorStack.back().type != LEFT_PAREN &&
+                   (getPrecedence(operatorStack.back().opcode) > precedence || (getPrecedence(operatorStack.back().opcode) == precedence && leftAssociative)))
+            {
+                emitOperator(operatorStack.back(), 1);
+                operatorStack.pop();
+            }
+            operatorStack.push(PendingOperator{OPERATOR, token.opcode});
+        }
+        else // RIGHT_PAREN or COMMA: nextToken guarantees a matching left parenthesis
+        {
+            while (operatorStack.back().type != LEFT_PAREN)
+            {
+                emitOperator(operatorStack.back(), 1);
+                operatorStack.pop();
+            }
+            if (token.type == COMMA) continue; // The call's parenthesis stays open for the next argument
+            operatorStack.pop();
+            // A function applies to the parenthesized arguments that just closed, the parenthesis counted them
+            if (!operatorStack.empty() && operatorStack.back().type == FUNCTION)
+            {
+                emitOperator(operatorStack.back(), token.slot);
+                operatorStack.pop();
+            }
+        }
+    }
+    if (!finishParse(inputExpression, state.expectNumber, !state.groups.empty(), error)) return false;
+
+    while (!operatorStack.empty())
+    {
+        emitOperator(operatorStack.back(), 1);
+        operatorStack.pop();
+    }
+    return true;
 }
 
 /*-----------------------------------------
 Evaluate Reverse Polish Notation Expression
 ------------------------------------------*/
-double Calculator::evaluateRPN(const std::vector<Calculator::Token>& rpnExpression) const
+// Walks the program once to check every operator has its operands and to record the deepest stack needed,
+// so evaluation can run on a fixed size stack without any further checks
+Calculator::CompiledExpression Calculator::compileRPN(const std::vector<Calculator::Token>& rpnExpression) const
+{
+    CompiledExpression compiled;
+    const EvalStatus status = validateRPN(rpnExpression, compiled.maxStackDepth, compiled.variableCount);
+    if (status != EVAL_OK) throw std::invalid_argument(describeError(EvalOutcome{std::nan(""), status, 0, 0}, ""));
+    compiled.rpnProgram = rpnExpression;
+    return compiled;
+}
+
+Calculator::EvalStatus Calculator::validateRPN(const std::vector<Calculator::Token>& rpnExpression, int& maxDepth, int& variableCount) const
 {
-    std::vector<double> evalStack;
-    // If token number push output
-    // If operator, check unary or binary, pop numbers from output, push result
-    // If function, pop number from output, push result
-    // return last remaining number, if more than 1 error
+    int depth = 0;
+    maxDepth = 0;
+    variableCount = 0;
     for (const Token& token : rpnExpression)
     {
         if (token.type == NUMBER)
         {
-            evalStack.push_back(std::stod(token.value));
+            depth++;
+            if (token.opcode == OP_VARIABLE && token.slot >= variableCount) variableCount = token.slot + 1;
         }
         else if (token.type == OPERATOR)
         {
-            if (token.value == "u-") // Unary minus
+            if (token.opcode == OP_NEGATE) // Unary minus
             {
-                if (evalStack.empty()) throw std::invalid_argument("Invalid expression: not enough operands");
-                double num = evalStack.back();
-                evalStack.pop_back();
-                evalStack.push_back(-num);
+                if (depth < 1) return EVAL_MISSING_OPERAND;
             }
             else
             {
-                if (evalStack.size() < 2) throw std::invalid_argument("Invalid expression: not enough operands");
-                double num2 = evalStack.back();
-                evalStack.pop_back();
-                double num1 = evalStack.back();
-                evalStack.pop_back();
-                
-                if (token.value == "+") evalStack.push_back(num1 + num2);
-                else if (token.value == "-") evalStack.push_back(num1 - num2);
-                else if (token.value == "*") evalStack.push_back(num1 * num2);
-                else if (token.value == "/")
-                {
-                    if (num2 == 0) throw std::runtime_error("Division by zero");
-                    evalStack.push_back(num1 / num2);
-                }
-                else if (token.value == "^") evalStack.push_back(std::pow(num1, num2));
+                if (depth < 2) return EVAL_MISSING_OPERAND;
+                depth--;
             }
         }
         else if (token.type == FUNCTION)
         {
-            if (evalStack.empty()) throw std::invalid_argument("Invalid expression: not enough operands");
-            double num = evalStack.back();
-            evalStack.pop_back();
-            
-            if (token.value == "sin") evalStack.push_back(Calculator::calcSin(num));
-            else if (token.value == "cos") evalStack.push_back(Calculator::calcCos(num));
-            else if (token.value == "tan") evalStack.push_back(Calculator::calcTan(num));
+            // slot holds the argument count
+            if (token.slot < 1) return EVAL_ARGUMENT_COUNT;
+            if (depth < token.slot) return EVAL_MISSING_OPERAND;
+            depth -= token.slot - 1;
         }
+        if (depth > maxDepth) maxDepth = depth;
     }
-    
-    if (evalStack.size() != 1) throw std::invalid_argument("Invalid expression: too many operands");
-    return evalStack.back();
-}
-
-/*@@@@@@@@@@@@@@@@
-evaluateExpression
-@@@@@@@@@@@@@@@@@@*/
-double Calculator::evaluateExpression(const std::string& inputExpression) const
-{
-    // Tokenize the expression, convert tokens to RPN and evaluate the RPN expression.
-    const std::vector<Calculator::Token> tokenExpression = tokenize(inputExpression);
-    const std::vector<Calculator::Token> rpnExpression = convertToRPN(tokenExpression);
-    double result = evaluateRPN(rpnExpression);
-    
-    // Save history to a file
-    if (settingSaveHistory) saveHistory(inputExpression, tokenExpression, rpnExpression, "calculation_history.txt", result);
 
-    // Adjust result close to zero before returning
-    if (std::fabs(result) < settingErrorThreshold) result = 0;
-    return result;
+    return (depth == 1) ? EVAL_OK : (depth == 0) ? EVAL_MISSING_OPERAND : EVAL_EXTRA_OPERAND;
 }
 
-/*--------------------
-Trignometric Functions
----------------------*/
-double Calculator::factorial(const int num) const 
+Calculator::EvalStatus Calculator::evaluateRPN(const std::vector<Calculator::Token>& rpnExpression, const double* variableValues, double* evalStack, const Settings& settings, double& result) const
 {
-    if (num <= 1) return 1;
-    double result = 1;
-    for (int index = 2; index <= num; ++index) 
+    // Operand counts were validated by validateRPN, so the stack never underflows
+    int top = -1;
+    for (const Token& token : rpnExpression)
     {
-        result *= index;
+        switch (token.opcode)
+        {
+            case OP_NUMBER: evalStack[++top] = token.number; break;
+            case OP_VARIABLE: evalStack[++top] = variableValues[token.slot]; break;
+            case OP_ADD: top--; evalStack[top] = evalStack[top] + evalStack[top + 1]; break;
+            case OP_SUBTRACT: top--; evalStack[top] = evalStack[top] - evalStack[top + 1]; break;
+            case OP_MULTIPLY: top--; evalStack[top] = evalStack[top] * evalStack[top + 1]; break;
+            case OP_DIVIDE:
+                top--;
+                if (evalStack[top + 1] == 0) return EVAL_DIVISION_BY_ZERO;
+                evalStack[top] = evalStack[top] / evalStack[top + 1];
+                break;
+            case OP_POWER: top--; evalStack[top] = std::pow(evalStack[top], evalStack[top + 1]); break;
+            case OP_NEGATE: evalStack[top] = -evalStack[top]; break;
+            case OP_SIN: evalStack[top] = calcSin(evalStack[top], settings); break;
+            case OP_COS: evalStack[top] = calcCos(evalStack[top], settings); break;
+            case OP_TAN:
+            {
+                double sinValue, cosValue;
+                calcSinCos(evalStack[top], sinValue, cosValue, settings); // Same rule as calcTan
+                if (std::fabs(cosValue) < settings.errorThreshold) return EVAL_TAN_UNDEFINED;
+                evalStack[top] = sinValue / cosValue;
+                break;
+            }
+            case OP_EXP:
+            case OP_LN:
+            case OP_LOG:
+            case OP_SQRT:
+            case OP_ABS:
+            case OP_ASIN:
+            case OP_ACOS:
+            case OP_ATAN:
+            case OP_SINH:
+            case OP_COSH:
+            case OP_TANH:
+            {
+                const EvalStatus status = applyFunction(token.opcode, evalStack[top], settings);
+                if (status != EVAL_OK) return status;
+                break;
+            }
+            case OP_MIN:
+            case OP_MAX:
+            {
+                // The arguments are the top slot entries, the result replaces the first
+                const int last = top;
+                top -= token.slot - 1;
+                double value = evalStack[top];
+                for (int entry = top + 1; entry <= last; entry++)
+                {
+                    value = (token.opcode == OP_MIN) ? MathKernels::minimum(value, evalStack[entry]) : MathKernels::maximum(value, evalStack[entry]);
+                }
+                evalStack[top] = value;
+                break;
+            }
+            default: break; // Parentheses and commas never reach the RPN program
+        }
     }
-    return result;
+    result = evalStack[0];
+    return EVAL_OK;
 }
 
-double Calculator::reduceAngle(const double angle) const 
+// evaluateRPN on Duals: every value is computed exactly as above, the derivatives ride along through the chain rule.
+// Values snapped to zero keep the derivatives of the unsnapped function, the snap only removes rounding noise.
+template <int Inputs, int Order>
+Calculator::EvalStatus Calculator::evaluateRPN(const std::vector<Calculator::Token>& rpnExpression, const Dual<Inputs, Order>* variableValues, Dual<Inputs, Order>* evalStack, const Settings& settings, Dual<Inputs, Order>& result) const
 {
-    double reduced = angle;
-    const double pi = 3.141592653589793;
-    // Bring angle to within [-pi, pi]
-    while (reduced > pi || reduced < -pi) 
+    // d/dx of sin and cos of x in the angle unit, once per angle unit: pi/180 per degree
+    const double angleScale = settings.radianMode ? 1 : 3.141592653589793 / 180;
+    int top = -1;
+    for (const Token& token : rpnExpression)
     {
-        if (reduced > pi) 
-        {
-            reduced -= 2 * pi;
-        }
-        else if (reduced < -pi) 
+        switch (token.opcode)
         {
-            reduced += 2 * pi;
+            case OP_NUMBER: evalStack[++top] = Dual<Inputs, Order>(token.number); break;
+            case OP_VARIABLE: evalStack[++top] = variableValues[token.slot]; break;
+            case OP_ADD: top--; evalStack[top] = evalStack[top] + evalStack[top + 1]; break;
+            case OP_SUBTRACT: top--; evalStack[top] = evalStack[top] - evalStack[top + 1]; break;
+            case OP_MULTIPLY: top--; evalStack[top] = evalStack[top] * evalStack[top + 1]; break;
+            case OP_DIVIDE:
+                top--;
+                if (evalStack[top + 1].value == 0) return EVAL_DIVISION_BY_ZERO;
+                evalStack[top] = evalStack[top] / evalStack[top + 1];
+                break;
+            case OP_POWER: top--; evalStack[top] = pow(evalStack[top], evalStack[top + 1]); break;
+            case OP_NEGATE: evalStack[top] = -evalStack[top]; break;
+            case OP_SIN:
+            case OP_COS:
+            case OP_TAN:
+            {
+                // One reduction gives the value and both derivatives
+                double sinValue, cosValue;
+                calcSinCos(evalStack[top].value, sinValue, cosValue, settings);
+                const double scale2 = angleScale * angleScale;
+                if (token.opcode == OP_SIN) evalStack[top] = evalStack[top].chain(sinValue, cosValue * angleScale, -sinValue * scale2);
+                else if (token.opcode == OP_COS) evalStack[top] = evalStack[top].chain(cosValue, -sinValue * angleScale, -cosValue * scale2);
+                else
+                {
+                    if (std::fabs(cosValue) < settings.errorThreshold) return EVAL_TAN_UNDEFINED;
+                    const double tanValue = sinValue / cosValue;
+                    const double first = angleScale / (cosValue * cosValue); // sec^2
+                    evalStack[top] = evalStack[top].chain(tanValue, first, 2 * tanValue * first * angleScale);
+                }
+                break;
+            }
+            case OP_EXP:
+            case OP_LN:
+            case OP_LOG:
+            case OP_SQRT:
+            case OP_ABS:
+            case OP_ASIN:
+            case OP_ACOS:
+            case OP_ATAN:
+            case OP_SINH:
+            case OP_COSH:
+            case OP_TANH:
+            {
+                double value = evalStack[top].value;
+                if (!clampToDomain(token.opcode, value, settings.errorThreshold)) return EVAL_DOMAIN_ERROR;
+                double first, second;
+                functionDerivatives(token.opcode, value, settings, first, second);
+                applyFunction(token.opcode, value, settings);
+                evalStack[top] = evalStack[top].chain(value, first, second);
+                break;
+            }
+            case OP_MIN:
+            case OP_MAX:
+            {
+                // The argument MathKernels::minimum/maximum pick, with its derivatives
+                const int last = top;
+                top -= token.slot - 1;
+                for (int entry = top + 1; entry <= last; entry++)
+                {
+                    const double value = evalStack[top].value, candidate = evalStack[entry].value;
+                    const bool keep = (token.opcode == OP_MIN) ? (value != value || value < candidate) : (value != value || value > candidate);
+                    if (!keep) evalStack[top] = evalStack[entry];
+                }
+                break;
+            }
+            default: break; // Parentheses and commas never reach the RPN program
         }
     }
-    return reduced;
+    result = evalStack[0];
+    return EVAL_OK;
 }
 
-double Calculator::calcSin(const double angle) const 
+/*------------
+Error Reporting
+-------------*/
+std::string Calculator::describeError(const EvalOutcome& outcome, const std::string& inputExpression)
 {
-    double radianAngle;
-    if (settingRadianMode)
-    {
-        radianAngle = angle;
-    }
-    else
+    // Parse errors quote the offending text
+    const std::string text = (outcome.position < inputExpression.length()) ? inputExpression.substr(outcome.position, outcome.length) : std::string();
+    switch (outcome.status)
     {
-        radianAngle = angle * 3.141592653589793 / 180.0; // Convert to radians if in degree mode
+        case EVAL_OK: return "";
+        case EVAL_DIVISION_BY_ZERO: return "Division by zero";
+        case EVAL_TAN_UNDEFINED: return "Tangent undefined at this angle";
+        case EVAL_DOMAIN_ERROR: return "Argument outside the domain of the function";
+        case EVAL_INVALID_EXPRESSION: return "Invalid expression";
+        case EVAL_INVALID_NUMBER: return "Invalid number format: " + text;
+        case EVAL_MULTIPLE_DECIMAL_POINTS: return "Invalid number format: multiple decimal points in " + text;
+        case EVAL_UNKNOWN_NAME: return "Unrecognized function or variable: " + text;
+        case EVAL_UNKNOWN_CHARACTER: return "Unrecognized character: " + text;
+        case EVAL_MISSING_LEFT_PAREN: return "Mismatched parenthesis, missing: '('";
+        case EVAL_MISSING_RIGHT_PAREN: return "Mismatched parenthesis, missing: ')'";
+        case EVAL_MISSING_OPERAND: return "Invalid expression: not enough operands";
+        case EVAL_EXTRA_OPERAND: return "Invalid expression: too many operands";
+        case EVAL_ARGUMENT_COUNT: return "Wrong number of arguments to " + text;
+        case EVAL_MISSING_VALUES: return "Missing values for expression variables";
     }
-    const double theta = reduceAngle(radianAngle);
-    double result = 0;
-    for (int index = 0; index < settingTaylorTerms; index++) 
-    {
-        int exponent = 2 * index + 1;
-        result += pow(-1, index) * pow(theta, exponent) / factorial(exponent); 
-    }
-    // Adjust result close to zero
-    if (std::fabs(result) < settingErrorThreshold) result = 0;
-    return result;
+    return "Invalid expression";
 }
 
-double Calculator::calcCos(const double angle) const 
+// The throwing API's view of an outcome: evaluation failures are std::runtime_error, everything else is bad input
+void Calculator::throwEvalError(const EvalOutcome& outcome, const std::string& inputExpression)
 {
-    double radianAngle;
-    if (settingRadianMode)
-    {
-        radianAngle = angle;
-    }
-    else
+    if (outcome.status == EVAL_DIVISION_BY_ZERO || outcome.status == EVAL_TAN_UNDEFINED || outcome.status == EVAL_DOMAIN_ERROR)
     {
-        radianAngle = angle * 3.141592653589793 / 180.0; // Convert to radians if in degree mode
+        throw std::runtime_error(describeError(outcome, inputExpression));
     }
-    const double theta = reduceAngle(radianAngle);
-    double result = 0;
-    for (int index = 0; index < settingTaylorTerms; index++) 
+    throw std::invalid_argument(describeError(outcome, inputExpression));
+}
+
+/*---------------------------------
+Compile Once, Evaluate Many
+----------------------------------*/
+Calculator::CompiledExpression Calculator::compile(const std::string& inputExpression, const std::vector<std::string>& variableNames) const
+{
+    const Settings settings = getSettings();
+    std::vector<Token> rpnExpression;
+    int maxDepth;
+    EvalOutcome error;
+    if (!parseToRPN(inputExpression, variableNames, rpnExpression, maxDepth, error)) throwEvalError(error, inputExpression);
+    bool usedSettings = false;
+    CompiledExpression compiled = compileRPN(optimizeRPN(rpnExpression, settings, usedSettings));
+    if (usedSettings)
     {
-        int exponent = 2 * index;
-        result += pow(-1, index) * pow(theta, exponent) / factorial(exponent);
+        compiled.unfolded = std::make_shared<const CompiledExpression>(compileRPN(rpnExpression));
+        compiled.foldedRadianMode = settings.radianMode;
+        compiled.foldedTaylorTerms = settings.taylorTerms;
+        compiled.foldedErrorThreshold = settings.errorThreshold;
     }
-    // Adjust result close to zero
-    if (std::fabs(result) < settingErrorThreshold) result = 0;
-    return result;
+    return compiled;
 }
 
-double Calculator::calcTan(const double angle) const 
+Calculator::CompiledExpression Calculator::compileNative(const std::string& inputExpression, const std::vector<std::string>& variableNames) const
 {
-    double cosValue = calcCos(angle);
-    if (std::fabs(cosValue) < settingErrorThreshold) throw std::runtime_error("Tangent undefined at this angle");
-    return calcSin(angle) / cosValue;
+    CompiledExpression compiled = compile(inputExpression, variableNames);
+    compiled.native = NativeCompiler::compile(compiled.rpnProgram, compiled.maxStackDepth); // The unfolded program stays interpreted
+    return compiled;
 }
 
-/*----------------------------------
-Time Value of Money Solver Functions
-------------------------------------*/
-
-// Future Value calculation
-double Calculator::calculateFV(double pv, double pmt, double i, double n) const
+const Calculator::CompiledExpression& Calculator::programFor(const Calculator::CompiledExpression& expression, const Settings& settings) const
 {
-    if (i == 0)
+    if (expression.unfolded && (settings.radianMode != expression.foldedRadianMode || settings.taylorTerms != expression.foldedTaylorTerms ||
+                                settings.errorThreshold != expression.foldedErrorThreshold))
     {
-        return -(pv + pmt * n);
+        return *expression.unfolded;
     }
-
-    double result = -pv * pow(1 + i, n) - pmt * ((pow(1 + i, n) - 1) / i);
-    if (std::fabs(result) < settingErrorThreshold) result = 0;
-    return result;
+    return expression;
 }
 
-
-// Present Value calculation
-double Calculator::calculatePV(double fv, double pmt, double i, double n) const
+/*--------------------
+RPN Program Optimizer
+---------------------*/
+// Rewrites the program in one pass over a symbolic stack: every stack entry remembers where its instructions
+// start in the output and, when it is a constant, its value. Operators whose operands are all constants are
+// evaluated now and replaced by their result; operators with an identity operand are dropped. Folding never hides
+// an error: division by zero, undefined tangents and domain errors are left for evaluation to report.
+std::vector<Calculator::Token> Calculator::optimizeRPN(const std::vector<Calculator::Token>& rpnExpression, const Settings& settings, bool& usedSettings) const
+{
+    struct Operand
+    {
+        size_t start;   // First instruction computing this operand
+        bool constant;  // Computed by a single OP_NUMBER instruction
+        double value;
+    };
+    std::vector<Token> output;
+    std::vector<Operand> operands;
+    output.reserve(rpnExpression.size());
+    usedSettings = false;
+
+    // Replaces the instructions of operands from start on with one literal
+    auto foldTo = [&](size_t start, double value)
+    {
+        output.erase(output.begin() + start, output.end());
+        output.push_back(Token{NUMBER, OP_NUMBER, value});
+        operands.push_back(Operand{start, true, value});
+    };
+
+    for (const Token& token : rpnExpression)
+    {
+        if (token.type == NUMBER)
+        {
+            operands.push_back(Operand{output.size(), token.opcode == OP_NUMBER, token.number});
+            output.push_back(token);
+            continue;
+        }
+
+        if (token.opcode == OP_MIN || token.opcode == OP_MAX)
+        {
+            // Folds when every argument is constant; min(x) and max(x) are x
+            const size_t first = operands.size() - token.slot;
+            bool constant = true;
+            double value = operands[first].value;
+            for (size_t index = first; index < operands.size(); index++)
+            {
+                constant = constant && operands[index].constant;
+                value = (token.opcode == OP_MIN) ? MathKernels::minimum(value, operands[index].value) : MathKernels::maximum(value, operands[index].value);
+            }
+            const Operand result = {operands[first].start, false, 0};
+            const Operand single = operands[first];
+            operands.resize(first);
+            if (constant) foldTo(result.start, value);
+            else if (token.slot == 1) operands.push_back(single);
+            else
+            {
+                operands.push_back(result);
+                output.push_back(token);
+            }
+            continue;
+        }
+
+        if (token.type == FUNCTION || token.opcode == OP_NEGATE)
+        {
+            const Operand operand = operands.back();
+            operands.pop_back();
+            if (operand.constant)
+            {
+                if (token.opcode == OP_NEGATE)
+                {
+                    foldTo(operand.start, -operand.value);
+                    continue;
+                }
+                if (token.opcode != OP_SIN && token.opcode != OP_COS && token.opcode != OP_TAN)
+                {
+                    double value = operand.value;
+                    if (applyFunction(token.opcode, value, settings) == EVAL_OK)
+                    {
+                        usedSettings = true;
+                        foldTo(operand.start, value);
+                        continue;
+                    }
+                    operands.push_back(Operand{operand.start, false, 0});
+                    output.push_back(token);
+                    continue;
+                }
+                double sinValue, cosValue;
+                calcSinCos(operand.value, sinValue, cosValue, settings);
+                if (token.opcode != OP_TAN || std::fabs(cosValue) >= settings.errorThreshold)
+                {
+                    usedSettings = true;
+                    foldTo(operand.start, (token.opcode == OP_SIN) ? sinValue : (token.opcode == OP_COS) ? cosValue : sinValue / cosValue);
+                    continue;
+                }
+            }
+            else if (token.opcode == OP_NEGATE && output.back().opcode == OP_NEGATE)
+            {
+                // --x
+                output.pop_back();
+                operands.push_back(operand);
+                continue;
+            }
+            operands.push_back(Operand{operand.start, false, 0});
+            output.push_back(token);
+            continue;
+        }
+
+        // Binary operators
+        const Operand right = operands.back();
+        operands.pop_back();
+        const Operand left = operands.back();
+        operands.pop_back();
+        const OpCode operation = token.opcode;
+
+        if (left.constant && right.constant && !(operation == OP_DIVIDE && right.value == 0))
+        {
+            const double a = left.value;
+            const double b = right.value;
+            foldTo(left.start, (operation == OP_ADD) ? a + b :
+                               (operation == OP_SUBTRACT) ? a - b :
+                               (operation == OP_MULTIPLY) ? a * b :
+                               (operation == OP_DIVIDE) ? a / b : std::pow(a, b));
+            continue;
+        }
+
+        const Operand result = {left.start, false, 0};
+        const bool rightIs0 = right.constant && right.value == 0;
+        const bool rightIs1 = right.constant && right.value == 1;
+        const bool leftIs1 = left.constant && left.value == 1;
+        // Only rewrites that give the same bits as the one-shot evaluation for every x, so compiled results match
+        // evaluateExpression and the history it records. Not x+0, 0+x or 0-x, which turn a -0 into +0 or back, and
+        // not x^2 = x*x, which differs from std::pow in the last place for some x.
+        if ((rightIs0 && operation == OP_SUBTRACT) || (rightIs1 && (operation == OP_MULTIPLY || operation == OP_DIVIDE || operation == OP_POWER)))
+        {
+            // x-0, x*1, x/1, x^1
+            output.pop_back();
+        }
+        else if (leftIs1 && operation == OP_MULTIPLY)
+        {
+            // 1*x
+            output.erase(output.begin() + left.start);
+        }
+        else
+        {
+            output.push_back(token);
+        }
+        operands.push_back(result);
+    }
+    return output;
+}
+
+double Calculator::evaluate(const Calculator::CompiledExpression& expression, const double* variableValues) const
 {
-    if (i == 0)
+    return evaluateCompiled(expression, variableValues, getSettings());
+}
+
+Calculator::EvalOutcome Calculator::tryEvaluate(const Calculator::CompiledExpression& expression, const double* variableValues) const
+{
+    return tryEvaluateCompiled(expression, variableValues, getSettings());
+}
+
+// tryEvaluateCompiled on Duals, through the interpreter: native code only computes values
+template <int Inputs, int Order>
+Dual<Inputs, Order> Calculator::evaluate(const Calculator::CompiledExpression& compiled, const Dual<Inputs, Order>* variableValues) const
+{
+    const Settings settings = getSettings();
+    const CompiledExpression& expression = programFor(compiled, settings);
+    if (expression.rpnProgram.empty()) throwEvalError(EvalOutcome{std::nan(""), EVAL_MISSING_OPERAND, 0, 0}, "");
+    if (expression.variableCount > 0 && variableValues == nullptr) throwEvalError(EvalOutcome{std::nan(""), EVAL_MISSING_VALUES, 0, 0}, "");
+
+    const int inlineStackDepth = 16; // Duals are up to 21 doubles each, and the inline stack is zeroed on every call
+    Dual<Inputs, Order> result;
+    EvalStatus status;
+    if (expression.maxStackDepth <= inlineStackDepth)
     {
-        return -(fv + pmt * n);
+        Dual<Inputs, Order> evalStack[inlineStackDepth];
+        status = evaluateRPN(expression.rpnProgram, variableValues, evalStack, settings, result);
     }
+    else
+    {
+        std::vector<Dual<Inputs, Order>> evalStack(expression.maxStackDepth);
+        status = evaluateRPN(expression.rpnProgram, variableValues, evalStack.data(), settings, result);
+    }
+    if (status != EVAL_OK) throwEvalError(EvalOutcome{std::nan(""), status, 0, 0}, "");
 
-    double result = -(fv / pow(1 + i, n)) - pmt * ((1 - pow(1 + i, -n)) / i);
-    if (std::fabs(result) < settingErrorThreshold) result = 0;
+    // Adjust result close to zero before returning
+    if (std::fabs(result.value) < settings.errorThreshold) result.value = 0;
     return result;
 }
 
+double Calculator::evaluateCompiled(const Calculator::CompiledExpression& expression, const double* variableValues, const Settings& settings) const
+{
+    const EvalOutcome outcome = tryEvaluateCompiled(expression, variableValues, settings);
+    if (outcome.status != EVAL_OK) throwEvalError(outcome, "");
+    return outcome.value;
+}
+
+Calculator::EvalOutcome Calculator::tryEvaluateCompiled(const Calculator::CompiledExpression& compiled, const double* variableValues, const Settings& settings) const
+{
+    const CompiledExpression& expression = programFor(compiled, settings);
+    EvalOutcome outcome = {std::nan(""), EVAL_OK, 0, 0};
+    if (expression.rpnProgram.empty()) outcome.status = EVAL_MISSING_OPERAND;
+    else if (expression.variableCount > 0 && variableValues == nullptr) outcome.status = EVAL_MISSING_VALUES;
+    if (outcome.status != EVAL_OK) return outcome;
+
+    // Typical expressions fit the inline stack; only pathologically deep programs fall back to the heap
+    const int inlineStackDepth = 64;
+    double result;
+    if (expression.native)
+    {
+        NativeContext context = {this, &settings, EVAL_OK};
+        outcome.status = expression.native->run(variableValues, result, context);
+    }
+    else if (expression.maxStackDepth <= inlineStackDepth)
+    {
+        double evalStack[inlineStackDepth];
+        outcome.status = evaluateRPN(expression.rpnProgram, variableValues, evalStack, settings, result);
+    }
+    else
+    {
+        std::vector<double> evalStack(expression.maxStackDepth);
+        outcome.status = evaluateRPN(expression.rpnProgram, variableValues, evalStack.data(), settings, result);
+    }
+
+    // Adjust result close to zero before returning
+    if (outcome.status == EVAL_OK) outcome.value = (std::fabs(result) < settings.errorThreshold) ? 0 : result;
+    return outcome;
+}
+
+/*--------------------------
+Batch (Columnar) Evaluation
+---------------------------*/
+void Calculator::evaluateBatch(const Calculator::CompiledExpression& expression, const double* x, size_t count, double* results, Calculator::EvalStatus* status) const
+{
+    const double* const variableColumns[1] = {x};
+    evaluateBatch(expression, variableColumns, count, results, status);
+}
+
+void Calculator::evaluateBatch(const Calculator::CompiledExpression& compiled, const double* const* variableColumns, size_t count, double* results, Calculator::EvalStatus* status) const
+{
+    const Settings settings = getSettings(); // One snapshot for the whole batch
+    const CompiledExpression& expression = programFor(compiled, settings);
+    if (expression.rpnProgram.empty()) throwEvalError(EvalOutcome{std::nan(""), EVAL_MISSING_OPERAND, 0, 0}, "");
+    if (expression.variableCount > 0 && variableColumns == nullptr) throwEvalError(EvalOutcome{std::nan(""), EVAL_MISSING_VALUES, 0, 0}, "");
+
+    // Each stack entry is a column of blockSize rows, so every opcode becomes a simple loop over the block
+    const size_t blockSize = 256;
+    std::vector<double> evalStack(expression.maxStackDepth * blockSize);
+    unsigned char rowStatus[blockSize];
+
+    for (size_t start = 0; start < count; start += blockSize)
+    {
+        const size_t rows = (count - start < blockSize) ? count - start : blockSize;
+        for (size_t row = 0; row < rows; row++) rowStatus[row] = EVAL_OK;
+
+        // depth counts the stack entries; a column pointer is only formed for an entry that exists
+        size_t depth = 0;
+        auto column = [&](size_t entry) { return evalStack.data() + entry * blockSize; };
+        for (const Token& token : expression.rpnProgram)
+        {
+            if (token.type == NUMBER)
+            {
+                double* top = column(depth++);
+                if (token.opcode == OP_NUMBER) for (size_t row = 0; row < rows; row++) top[row] = token.number;
+                else
+                {
+                    const double* values = variableColumns[token.slot] + start;
+                    for (size_t row = 0; row < rows; row++) top[row] = values[row];
+                }
+                continue;
+            }
+            if (token.opcode >= OP_ADD && token.opcode <= OP_POWER) // + - * / ^
+            {
+                double* lhs = column(depth - 2); // Left operand, and the result
+                const double* rhs = column(depth - 1);
+                depth--;
+                switch (token.opcode)
+                {
+                    case OP_ADD: for (size_t row = 0; row < rows; row++) lhs[row] = lhs[row] + rhs[row]; break;
+                    case OP_SUBTRACT: for (size_t row = 0; row < rows; row++) lhs[row] = lhs[row] - rhs[row]; break;
+                    case OP_MULTIPLY: for (size_t row = 0; row < rows; row++) lhs[row] = lhs[row] * rhs[row]; break;
+                    case OP_DIVIDE:
+                        // Flag the row instead of throwing; the first error of a row is the one reported
+                        for (size_t row = 0; row < rows; row++)
+                        {
+                            rowStatus[row] = (rowStatus[row] == EVAL_OK && rhs[row] == 0) ? static_cast<unsigned char>(EVAL_DIVISION_BY_ZERO) : rowStatus[row];
+                            lhs[row] = lhs[row] / rhs[row];
+                        }
+                        break;
+                    default: for (size_t row = 0; row < rows; row++) lhs[row] = std::pow(lhs[row], rhs[row]); break;
+                }
+                continue;
+            }
+
+            double* top = column(depth - 1); // Operand of a function, first argument of min and max
+            switch (token.opcode)
+            {
+                case OP_NEGATE:
+                    for (size_t row = 0; row < rows; row++) top[row] = -top[row];
+                    break;
+                case OP_SIN:
+                    calcSinCosBlock(top, top, nullptr, rows, settings);
+                    break;
+                case OP_COS:
+                    calcSinCosBlock(top, nullptr, top, rows, settings);
+                    break;
+                case OP_TAN:
+                {
+                    // Same rule as calcTan, reported per row
+                    double cosValues[blockSize];
+                    calcSinCosBlock(top, top, cosValues, rows, settings);
+                    for (size_t row = 0; row < rows; row++)
+                    {
+                        const bool undefined = std::fabs(cosValues[row]) < settings.errorThreshold;
+                        rowStatus[row] = (rowStatus[row] == EVAL_OK && undefined) ? static_cast<unsigned char>(EVAL_TAN_UNDEFINED) : rowStatus[row];
+                        top[row] = undefined ? 0 : top[row] / cosValues[row];
+                    }
+                    break;
+                }
+                case OP_EXP:
+                case OP_LN:
+                case OP_LOG:
+                case OP_SQRT:
+                case OP_ABS:
+                case OP_ASIN:
+                case OP_ACOS:
+                case OP_ATAN:
+                case OP_SINH:
+                case OP_COSH:
+                case OP_TANH:
+                    applyFunctionBlock(token.opcode, top, rowStatus, rows, settings);
+                    break;
+                case OP_MIN:
+                case OP_MAX:
+                {
+                    // The arguments are the top slot columns, folded into the first one
+                    double* first = column(depth - token.slot);
+                    for (size_t entry = depth - token.slot + 1; entry < depth; entry++)
+                    {
+                        const double* argument = column(entry);
+                        if (token.opcode == OP_MIN) for (size_t row = 0; row < rows; row++) first[row] = MathKernels::minimum(first[row], argument[row]);
+                        else for (size_t row = 0; row < rows; row++) first[row] = MathKernels::maximum(first[row], argument[row]);
+                    }
+                    depth -= token.slot - 1;
+                    break;
+                }
+                default: break; // Parentheses and commas never reach the RPN program
+            }
+        }
+
+        // Adjust results close to zero and mark failed rows
+        const double* top = column(0); // A validated program leaves exactly one entry
+        const double notANumber = std::nan("");
+        for (size_t row = 0; row < rows; row++)
+        {
+            double result = (std::fabs(top[row]) < settings.errorThreshold) ? 0 : top[row];
+            results[start + row] = (rowStatus[row] == EVAL_OK) ? result : notANumber;
+        }
+        if (status != nullptr)
+        {
+            for (size_t row = 0; row < rows; row++) status[start + row] = static_cast<EvalStatus>(rowStatus[row]);
+        }
+    }
+}
+
+/*-------------------------
+Parallel Expression Batches
+--------------------------*/
+Calculator::EvalScratch& Calculator::threadScratch()
+{
+    // Grows to the largest expression a thread has seen, then stops allocating
+    static thread_local EvalScratch scratch;
+    return scratch;
+}
+
+void Calculator::evaluateItem(const std::string& expression, const Settings& settings, EvalScratch& scratch, EvalResult& result) const
+{
+    // Runs on ThreadPool workers, which must not throw: anything the pipeline still throws (out of memory) fails this
+    // item alone
+    try
+    {
+        const EvalOutcome outcome = evaluatePipeline(expression, {}, nullptr, settings, scratch, false);
+        result.value = outcome.value;
+        result.status = outcome.status;
+        if (outcome.status == EVAL_OK) result.error.clear();
+        else result.error = describeError(outcome, expression);
+    }
+    catch (const std::exception& error)
+    {
+        result.value = std::nan("");
+        result.status = EVAL_INVALID_EXPRESSION;
+        result.error = error.what();
+    }
+}
+
+std::vector<Calculator::EvalResult> Calculator::evaluateAll(const std::vector<std::string>& expressions, unsigned threads) const
+{
+    const Settings settings = getSettings();
+    std::vector<EvalResult> results(expressions.size());
+
+    // Chunks are small enough to balance across threads and large enough to amortize the scheduling
+    const size_t grainSize = 256;
+    ThreadPool::shared().parallelFor(expressions.size(), grainSize, [&](size_t begin, size_t end)
+    {
+        EvalScratch& scratch = threadScratch();
+        for (size_t index = begin; index < end; index++) evaluateItem(expressions[index], settings, scratch, results[index]);
+    }, threads);
+    return results;
+}
+
+size_t Calculator::evaluateStream(std::istream& input, const std::function<void(const EvalResult&)>& sink, size_t chunkSize) const
+{
+    if (chunkSize == 0) chunkSize = 1;
+    std::vector<std::string> lines(chunkSize); // Reused so each line keeps its capacity between chunks
+    size_t total = 0;
+    while (input)
+    {
+        size_t count = 0;
+        while (count < chunkSize && std::getline(input, lines[count])) count++;
+        if (count == 0) break;
+
+        if (count < chunkSize) lines.resize(count); // Last, partial chunk
+        const std::vector<EvalResult> results = evaluateAll(lines);
+        for (const EvalResult& result : results) sink(result);
+        total += count;
+    }
+    return total;
+}
+
+/*@@@@@@@@@@@@@@@@
+evaluateExpression
+@@@@@@@@@@@@@@@@@@*/
+double Calculator::evaluateExpression(const std::string& inputExpression) const
+{
+    return evaluateExpression(inputExpression, {}, {});
+}
+
+double Calculator::evaluateExpression(const std::string& inputExpression, const std::vector<std::string>& variableNames, const std::vector<double>& variableValues) const
+{
+    const EvalOutcome outcome = tryEvaluate(inputExpression, variableNames, variableValues);
+    if (outcome.status != EVAL_OK) throwEvalError(outcome, inputExpression);
+    // tryEvaluate leaves history failures to the writer, the throwing form reports them
+    if (getSettings().saveHistory) std::atomic_load(&historyWriter)->throwIfFailed();
+    return outcome.value;
+}
+
+Calculator::EvalOutcome Calculator::tryEvaluate(const std::string& inputExpression) const
+{
+    return tryEvaluate(inputExpression, {}, {});
+}
+
+Calculator::EvalOutcome Calculator::tryEvaluate(const std::string& inputExpression, const std::vector<std::string>& variableNames, const std::vector<double>& variableValues) const
+{
+    if (variableValues.size() < variableNames.size()) return EvalOutcome{std::nan(""), EVAL_MISSING_VALUES, 0, 0};
+
+    // One settings snapshot for the whole evaluation, so a concurrent settings change cannot tear it
+    return evaluatePipeline(inputExpression, variableNames, variableValues.data(), getSettings(), threadScratch(), true);
+}
+
+Calculator::EvalOutcome Calculator::evaluatePipeline(const std::string& inputExpression, const std::vector<std::string>& variableNames, const double* variableValues,
+                                                     const Settings& settings, EvalScratch& scratch, bool useCache) const
+{
+    // Parse the expression straight to RPN and evaluate the RPN expression.
+    CALCULATOR_METRICS_COUNT(metrics, COUNTER_EVALUATIONS, 1);
+    EvalOutcome outcome = {std::nan(""), EVAL_OK, 0, 0};
+    CALCULATOR_METRICS_START(stageStart);
+    int maxDepth;
+    const bool parsed = parseToRPN(inputExpression, variableNames, scratch.outputStack, maxDepth, outcome);
+    CALCULATOR_METRICS_RECORD(metrics, STAGE_PARSE, stageStart);
+    if (!parsed)
+    {
+        CALCULATOR_METRICS_ERROR(metrics, outcome.status);
+        return outcome;
+    }
+
+    // Repeated expressions skip evaluation. The cache is loaded once: enableResultCache may swap it meanwhile.
+    std::string cacheKey;
+    const std::shared_ptr<ResultCache> cache = useCache ? std::atomic_load(&resultCache) : nullptr;
+    if (cache)
+    {
+        cacheKey = resultCacheKey(scratch.outputStack, variableValues, settings);
+        if (cache->find(cacheKey, outcome.value))
+        {
+            CALCULATOR_METRICS_COUNT(metrics, COUNTER_CACHE_HITS, 1);
+            if (settings.saveHistory) saveHistory(inputExpression, scratch.outputStack, variableNames, variableValues, outcome.value, settings);
+            return outcome;
+        }
+        CALCULATOR_METRICS_COUNT(metrics, COUNTER_CACHE_MISSES, 1);
+        CALCULATOR_METRICS_RESTART(stageStart); // The lookup belongs to no stage
+    }
+
+    // The parser only accepts well formed expressions, so the program needs no validateRPN pass
+    if (scratch.evalStack.size() < size_t(maxDepth)) scratch.evalStack.resize(maxDepth);
+    double result;
+    outcome.status = evaluateRPN(scratch.outputStack, variableValues, scratch.evalStack.data(), settings, result);
+    CALCULATOR_METRICS_RECORD(metrics, STAGE_EVALUATE_RPN, stageStart);
+    if (outcome.status != EVAL_OK) // Failed evaluations are not cached
+    {
+        CALCULATOR_METRICS_ERROR(metrics, outcome.status);
+        return outcome;
+    }
+    outcome.value = (std::fabs(result) < settings.errorThreshold) ? 0 : result;
+    if (cache) cache->insert(std::move(cacheKey), outcome.value);
+
+    // Save history to a file
+    if (settings.saveHistory)
+    {
+        CALCULATOR_METRICS_RESTART(stageStart);
+        saveHistory(inputExpression, scratch.outputStack, variableNames, variableValues, outcome.value, settings);
+        CALCULATOR_METRICS_RECORD(metrics, STAGE_SAVE_HISTORY, stageStart);
+    }
+
+    return outcome;
+}
+
+/*--------------------
+Trignometric Functions
+---------------------*/
+// The series, their coefficient tables and the angle reductions live in ConstMath, so that compile-time evaluation
+// (ConstExpression) runs the same code
+double Calculator::reduceAngle(const double angle, int& quadrant) const 
+{
+    // Payne-Hanek arguments take their mantissa from frexp here rather than from the constexpr split
+    const double magnitude = std::fabs(angle);
+    if (magnitude >= ConstMath::codyWaiteLimit && std::isfinite(angle))
+    {
+        int exponent;
+        const double mantissa = std::frexp(magnitude, &exponent);
+        return ConstMath::reduceLargeAngle(angle, uint64_t(std::ldexp(mantissa, 53)), exponent, quadrant);
+    }
+    return ConstMath::reduceAngle(angle, quadrant);
+}
+
+int Calculator::taylorTermsUsed(const Settings& settings) const
+{
+    return (settings.taylorTerms < ConstMath::maxTaylorTerms) ? settings.taylorTerms : ConstMath::maxTaylorTerms;
+}
+
+double Calculator::toReducedRadians(const double angle, int& quadrant, const Settings& settings) const
+{
+    if (settings.radianMode) return reduceAngle(angle, quadrant);
+
+    return ConstMath::reduceDegrees(std::fmod(angle, 360.0), quadrant);
+}
+
+double Calculator::calcSin(const double angle, const Settings& settings) const
+{
+    int quadrant;
+    const double theta = toReducedRadians(angle, quadrant, settings);
+    return ConstMath::sinReduced(theta, quadrant, taylorTermsUsed(settings), settings.errorThreshold);
+}
+
+double Calculator::calcCos(const double angle, const Settings& settings) const
+{
+    int quadrant;
+    const double theta = toReducedRadians(angle, quadrant, settings);
+    return ConstMath::cosReduced(theta, quadrant, taylorTermsUsed(settings), settings.errorThreshold);
+}
+
+void Calculator::calcSinCos(const double angle, double& sinValue, double& cosValue, const Settings& settings) const
+{
+    int quadrant;
+    const double theta = toReducedRadians(angle, quadrant, settings);
+    const int terms = taylorTermsUsed(settings);
+    const double sinTheta = ConstMath::sinSeries(theta, terms);
+    const double cosTheta = ConstMath::cosSeries(theta, terms);
+    sinValue = (quadrant & 1) ? cosTheta : sinTheta;
+    cosValue = (quadrant & 1) ? sinTheta : cosTheta;
+    if (quadrant & 2) sinValue = -sinValue;
+    if ((quadrant + 1) & 2) cosValue = -cosValue;
+    // Adjust results close to zero
+    if (std::fabs(sinValue) < settings.errorThreshold) sinValue = 0;
+    if (std::fabs(cosValue) < settings.errorThreshold) cosValue = 0;
+}
+
+double Calculator::calcTan(const double angle, const Settings& settings) const
+{
+    double sinValue, cosValue;
+    calcSinCos(angle, sinValue, cosValue, settings); // Reduces the angle once for both series
+    if (std::fabs(cosValue) < settings.errorThreshold) throw std::runtime_error("Tangent undefined at this angle");
+    return sinValue / cosValue;
+}
+
+// Block form for batch evaluation: angles are reduced first, then each Horner step runs across the whole block
+// so the loops vectorize. Either output may be null; angles may alias an output.
+void Calculator::calcSinCosBlock(const double* angles, double* sinValues, double* cosValues, size_t count, const Settings& settings) const
+{
+    const int terms = taylorTermsUsed(settings);
+    const size_t chunkSize = 256;
+    double theta[chunkSize];
+    double theta2[chunkSize];
+    double sinSum[chunkSize];
+    double cosSum[chunkSize];
+    int quadrant[chunkSize];
+
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++)
+        {
+            theta[row] = toReducedRadians(angles[start + row], quadrant[row], settings);
+            theta2[row] = theta[row] * theta[row];
+        }
+
+        // Both series are needed whenever a row falls in an odd quadrant
+        const double sinLeading = (terms > 0) ? ConstMath::sinCoefficients.values[terms - 1] : 0;
+        const double cosLeading = (terms > 0) ? ConstMath::cosCoefficients.values[terms - 1] : 0;
+        for (size_t row = 0; row < rows; row++)
+        {
+            sinSum[row] = sinLeading;
+            cosSum[row] = cosLeading;
+        }
+        for (int index = terms - 2; index >= 0; index--)
+        {
+            const double sinCoefficient = ConstMath::sinCoefficients.values[index];
+            const double cosCoefficient = ConstMath::cosCoefficients.values[index];
+            for (size_t row = 0; row < rows; row++)
+            {
+                sinSum[row] = sinSum[row] * theta2[row] + sinCoefficient;
+                cosSum[row] = cosSum[row] * theta2[row] + cosCoefficient;
+            }
+        }
+
+        for (size_t row = 0; row < rows; row++)
+        {
+            const double sinTheta = sinSum[row] * theta[row];
+            const bool odd = quadrant[row] & 1;
+            double sinResult = odd ? cosSum[row] : sinTheta;
+            double cosResult = odd ? sinTheta : cosSum[row];
+            if (quadrant[row] & 2) sinResult = -sinResult;
+            if ((quadrant[row] + 1) & 2) cosResult = -cosResult;
+            if (sinValues != nullptr) sinValues[start + row] = (std::fabs(sinResult) < settings.errorThreshold) ? 0 : sinResult;
+            if (cosValues != nullptr) cosValues[start + row] = (std::fabs(cosResult) < settings.errorThreshold) ? 0 : cosResult;
+        }
+    }
+}
+
+/*--------------------
+Elementary Functions
+---------------------*/
+bool Calculator::clampToDomain(OpCode function, double& value, double errorThreshold)
+{
+    switch (function)
+    {
+        case OP_LN:
+        case OP_LOG: return !(value <= 0);
+        case OP_SQRT:
+            if (value >= 0 || value != value) return true;
+            if (value <= -errorThreshold) return false;
+            value = 0; // Rounding noise below zero
+            return true;
+        case OP_ASIN:
+        case OP_ACOS:
+            if (!(std::fabs(value) > 1)) return true;
+            if (std::fabs(value) > 1 + errorThreshold) return false;
+            value = (value > 0) ? 1 : -1; // Rounding noise past +-1
+            return true;
+        default: return true;
+    }
+}
+
+double Calculator::adjustResult(OpCode function, double value, const Settings& settings)
+{
+    // Inverse trig answers in the angle unit sin and cos take
+    if ((function == OP_ASIN || function == OP_ACOS || function == OP_ATAN) && !settings.radianMode) value *= 180 / 3.141592653589793;
+    // Functions that cross zero snap to it, like the trig functions; exp, cosh, sqrt and abs are exact there or never reach it
+    if (function != OP_EXP && function != OP_COSH && function != OP_SQRT && function != OP_ABS && std::fabs(value) < settings.errorThreshold) value = 0;
+    return value;
+}
+
+Calculator::EvalStatus Calculator::applyFunction(OpCode function, double& value, const Settings& settings) const
+{
+    if (!clampToDomain(function, value, settings.errorThreshold)) return EVAL_DOMAIN_ERROR;
+    switch (function)
+    {
+        case OP_EXP: value = MathKernels::exp(value); break;
+        case OP_LN: value = MathKernels::ln(value); break;
+        case OP_LOG: value = MathKernels::log10(value); break;
+        case OP_SQRT: value = std::sqrt(value); break; // A single instruction, correctly rounded
+        case OP_ABS: value = std::fabs(value); break;
+        case OP_ASIN: value = MathKernels::asin(value); break;
+        case OP_ACOS: value = MathKernels::acos(value); break;
+        case OP_ATAN: value = MathKernels::atan(value); break;
+        case OP_SINH: value = MathKernels::sinh(value); break;
+        case OP_COSH: value = MathKernels::cosh(value); break;
+        case OP_TANH: value = MathKernels::tanh(value); break;
+        default: break;
+    }
+    value = adjustResult(function, value, settings);
+    return EVAL_OK;
+}
+
+void Calculator::functionDerivatives(OpCode function, double x, const Settings& settings, double& first, double& second)
+{
+    switch (function)
+    {
+        case OP_EXP: first = second = MathKernels::exp(x); break;
+        case OP_LN:
+        case OP_LOG:
+        {
+            const double scale = (function == OP_LN) ? 1 : 1 / 2.302585092994045684; // 1 / ln 10
+            first = scale / x;
+            second = -first / x;
+            break;
+        }
+        case OP_SQRT:
+        {
+            const double root = std::sqrt(x);
+            first = 0.5 / root;
+            second = -0.5 * first / x;
+            break;
+        }
+        case OP_ABS:
+            first = (x < 0) ? -1 : (x > 0) ? 1 : 0;
+            second = 0;
+            break;
+        case OP_ASIN:
+        case OP_ACOS:
+        {
+            const double rest = 1 - x * x;
+            first = 1 / std::sqrt(rest);
+            second = x * first / rest;
+            if (function == OP_ACOS)
+            {
+                first = -first;
+                second = -second;
+            }
+            break;
+        }
+        case OP_ATAN:
+            first = 1 / (1 + x * x);
+            second = -2 * x * first * first;
+            break;
+        case OP_SINH: first = MathKernels::cosh(x); second = MathKernels::sinh(x); break;
+        case OP_COSH: first = MathKernels::sinh(x); second = MathKernels::cosh(x); break;
+        case OP_TANH:
+        {
+            const double tanh = MathKernels::tanh(x);
+            first = 1 - tanh * tanh;
+            second = -2 * tanh * first;
+            break;
+        }
+        default: first = second = 0; break;
+    }
+    // Inverse trig answers in degrees unless radianMode
+    if ((function == OP_ASIN || function == OP_ACOS || function == OP_ATAN) && !settings.radianMode)
+    {
+        first *= 180 / 3.141592653589793;
+        second *= 180 / 3.141592653589793;
+    }
+}
+
+// Block form for batch evaluation, the same three steps each run across the block: domain check, kernel, adjustment
+void Calculator::applyFunctionBlock(OpCode function, double* values, unsigned char* rowStatus, size_t count, const Settings& settings) const
+{
+    const double notANumber = std::nan("");
+    for (size_t row = 0; row < count; row++)
+    {
+        if (clampToDomain(function, values[row], settings.errorThreshold)) continue;
+        if (rowStatus[row] == EVAL_OK) rowStatus[row] = EVAL_DOMAIN_ERROR;
+        values[row] = notANumber;
+    }
+    switch (function)
+    {
+        case OP_EXP: MathKernels::expBlock(values, values, count); break;
+        case OP_LN: MathKernels::lnBlock(values, values, count); break;
+        case OP_LOG: MathKernels::log10Block(values, values, count); break;
+        case OP_SQRT: for (size_t row = 0; row < count; row++) values[row] = std::sqrt(values[row]); break;
+        case OP_ABS: for (size_t row = 0; row < count; row++) values[row] = std::fabs(values[row]); break;
+        case OP_ASIN: MathKernels::asinBlock(values, values, count); break;
+        case OP_ACOS: MathKernels::acosBlock(values, values, count); break;
+        case OP_ATAN: MathKernels::atanBlock(values, values, count); break;
+        case OP_SINH: MathKernels::sinhBlock(values, values, count); break;
+        case OP_COSH: MathKernels::coshBlock(values, values, count); break;
+        case OP_TANH: MathKernels::tanhBlock(values, values, count); break;
+        default: break;
+    }
+    for (size_t row = 0; row < count; row++) values[row] = adjustResult(function, values[row], settings);
+}
+
+/*----------------------------------
+Time Value of Money Solver Functions
+------------------------------------*/
+
+// Results within errorThreshold of zero become 0. On a Dual only the value is snapped: the derivatives stay those of
+// the formula, the snap only removes rounding noise.
+static double snapToZero(double value, double errorThreshold)
+{
+    return (std::fabs(value) < errorThreshold) ? 0 : value;
+}
+
+template <int Inputs, int Order>
+static Dual<Inputs, Order> snapToZero(Dual<Inputs, Order> value, double errorThreshold)
+{
+    value.value = snapToZero(value.value, errorThreshold);
+    return value;
+}
+
+// At i = 0 the formulas are 0/0 and the kernels return their limit. A Dual also needs the slope and curvature in i
+// there, from the series limit + first * i + second * i^2; its value stays the limit, as for double.
+static double zeroRateSeries(double limit, double, double, double)
+{
+    return limit;
+}
+
+template <int Inputs, int Order>
+static Dual<Inputs, Order> zeroRateSeries(const Dual<Inputs, Order>& limit, const Dual<Inputs, Order>& i, const Dual<Inputs, Order>& first, const Dual<Inputs, Order>& second)
+{
+    Dual<Inputs, Order> result = limit + i * (first + i * second);
+    result.value = limit.value;
+    return result;
+}
+
+// Row kernels shared by the scalar, batch and Dual solvers. growth = (1 + i)^n is computed once per row by the caller.
+template <class Number>
+static Number futureValue(const Number& pv, const Number& pmt, const Number& i, const Number& n, const Number& growth, double errorThreshold)
+{
+    if (i == 0) return zeroRateSeries(-(pv + pmt * n), i, -(pv * n + pmt * (n * (n - 1) / 2)), -(pv * (n * (n - 1) / 2) + pmt * (n * (n - 1) * (n - 2) / 6)));
+    return snapToZero(-pv * growth - pmt * ((growth - 1) / i), errorThreshold);
+}
+
+template <class Number>
+static Number presentValue(const Number& fv, const Number& pmt, const Number& i, const Number& n, const Number& growth, double errorThreshold)
+{
+    if (i == 0) return zeroRateSeries(-(fv + pmt * n), i, fv * n + pmt * (n * (n + 1) / 2), -(fv * (n * (n + 1) / 2) + pmt * (n * (n + 1) * (n + 2) / 6)));
+    const Number discount = 1 / growth; // (1 + i)^-n
+    return snapToZero(-(fv * discount) - pmt * ((1 - discount) / i), errorThreshold);
+}
+
+template <class Number>
+static Number payment(const Number& pv, const Number& fv, const Number& i, const Number& n, const Number& growth, double errorThreshold)
+{
+    if (i <= 0 || n <= 0) return std::nan(""); // Batch rows report invalid input as NaN, calculatePMT throws first
+    const Number discount = 1 / growth; // (1 + i)^-n
+    return snapToZero((-pv * i - (fv * i) * discount) / (1 - discount), errorThreshold);
+}
+
+// Runs rowRange over rows [0, count) on the shared ThreadPool, like evaluateAll and AmortizationSchedule, with at
+// most threads threads (0 = all of them, one per core); the caller's thread works on the ranges too
+template <class RowRange>
+static void forEachRowRange(size_t count, unsigned threads, RowRange rowRange)
+{
+    const size_t grainSize = 16384; // Below this, handing rows to another thread costs more than the rows
+    if (threads == 1 || count <= grainSize)
+    {
+        rowRange(size_t(0), count); // No std::function, so the common single threaded call stays allocation free
+        return;
+    }
+    ThreadPool::shared().parallelFor(count, grainSize, rowRange, threads);
+}
+
+// Runs a row kernel over struct-of-arrays inputs in blocks: the (1 + i)^n pass comes first so the arithmetic pass
+// is a straight loop the compiler can vectorize
+template <class Kernel>
+static void tvmBatch(const double* a, const double* b, const double* i, const double* n, double* out, size_t count,
+                     unsigned threads, double errorThreshold, Kernel kernel)
+{
+    forEachRowRange(count, threads, [=](size_t begin, size_t end)
+    {
+        const size_t blockSize = 256;
+        double growth[blockSize];
+        for (size_t start = begin; start < end; start += blockSize)
+        {
+            const size_t rows = (end - start < blockSize) ? end - start : blockSize;
+            for (size_t row = 0; row < rows; row++) growth[row] = std::pow(1 + i[start + row], n[start + row]);
+            for (size_t row = 0; row < rows; row++)
+            {
+                const size_t index = start + row;
+                out[index] = kernel(a[index], b[index], i[index], n[index], growth[row], errorThreshold);
+            }
+        }
+    });
+}
+
+// Future Value calculation
+double Calculator::calculateFV(double pv, double pmt, double i, double n) const
+{
+    return futureValue(pv, pmt, i, n, pow(1 + i, n), getSettings().errorThreshold);
+}
+
+template <int Inputs, int Order>
+Dual<Inputs, Order> Calculator::calculateFV(const Dual<Inputs, Order>& pv, const Dual<Inputs, Order>& pmt, const Dual<Inputs, Order>& i, const Dual<Inputs, Order>& n) const
+{
+    return futureValue(pv, pmt, i, n, pow(1 + i, n), getSettings().errorThreshold);
+}
+
+
+// Present Value calculation
+double Calculator::calculatePV(double fv, double pmt, double i, double n) const
+{
+    return presentValue(fv, pmt, i, n, pow(1 + i, n), getSettings().errorThreshold);
+}
+
+template <int Inputs, int Order>
+Dual<Inputs, Order> Calculator::calculatePV(const Dual<Inputs, Order>& fv, const Dual<Inputs, Order>& pmt, const Dual<Inputs, Order>& i, const Dual<Inputs, Order>& n) const
+{
+    return presentValue(fv, pmt, i, n, pow(1 + i, n), getSettings().errorThreshold);
+}
+
 // Payment calculation
 double Calculator::calculatePMT(double pv, double fv, double i, double n) const
 {
@@ -397,92 +1783,466 @@ double Calculator::calculatePMT(double pv, double fv, double i, double n) const
         throw std::invalid_argument("Interest rate and number of periods must be greater than zero.");
     }
 
-    double result = (-pv * i - (fv * i) / pow(1 + i, n)) / (1 - pow(1 + i, -n));
-    if (std::fabs(result) < settingErrorThreshold) result = 0;
-    return result;
+    return payment(pv, fv, i, n, pow(1 + i, n), getSettings().errorThreshold);
 }
 
-// Interest rate calculation using Newton-Raphson
-double Calculator::calculateInterest(double pv, double fv, double pmt, double n) const
+template <int Inputs, int Order>
+Dual<Inputs, Order> Calculator::calculatePMT(const Dual<Inputs, Order>& pv, const Dual<Inputs, Order>& fv, const Dual<Inputs, Order>& i, const Dual<Inputs, Order>& n) const
 {
-    if (n <= 0) throw std::invalid_argument("Number of periods must be greater than zero.");
+    if (i <= 0 || n <= 0)
+    {
+        throw std::invalid_argument("Interest rate and number of periods must be greater than zero.");
+    }
 
-    double guess = settingInitialGuessInterest;
-    double diff = 1;
-    double newGuess;
-    int iterations = 0;
-    int maxIterations = 1000;
+    return payment(pv, fv, i, n, pow(1 + i, n), getSettings().errorThreshold);
+}
+
+/*
+Batch TVM Solvers
+*/
+void Calculator::calculateFVBatch(const double* pv, const double* pmt, const double* i, const double* n, double* out, size_t count, unsigned threads) const
+{
+    tvmBatch(pv, pmt, i, n, out, count, threads, getSettings().errorThreshold, futureValue<double>);
+}
+
+void Calculator::calculatePVBatch(const double* fv, const double* pmt, const double* i, const double* n, double* out, size_t count, unsigned threads) const
+{
+    tvmBatch(fv, pmt, i, n, out, count, threads, getSettings().errorThreshold, presentValue<double>);
+}
+
+void Calculator::calculatePMTBatch(const double* pv, const double* fv, const double* i, const double* n, double* out, size_t count, unsigned threads) const
+{
+    tvmBatch(pv, fv, i, n, out, count, threads, getSettings().errorThreshold, payment<double>);
+}
+
+/*
+Interest Rate Solver
+*/
+// h(i) = pv*(1+i)^n + pmt*((1+i)^n - 1)/i + fv, zero at the rate that balances the cash flows.
+// expm1/log1p keep the annuity factor accurate near i = 0, where the closed form divides 0 by 0.
+template <class Number>
+static Number interestEquation(double pv, double fv, double pmt, double n, const Number& i)
+{
+    using std::expm1;
+    using std::log1p;
+    const Number growthMinusOne = expm1(n * log1p(i));
+    // Series around i = 0: annuity = n + n(n-1)/2 * i + ...
+    const Number annuity = (i < 1e-8 && i > -1e-8) ? n + n * (n - 1) / 2 * i : growthMinusOne / i;
+    return pv * (growthMinusOne + 1) + pmt * annuity + fv;
+}
+
+// h and its slope for Newton's method, from one evaluation on a Dual in i
+static void interestEquation(double pv, double fv, double pmt, double n, double i, double& value, double& slope)
+{
+    const Dual<1> equation = interestEquation(pv, fv, pmt, n, Dual<1>::variable(i, 0));
+    value = equation.value;
+    slope = equation.gradient[0];
+}
+
+// Starting rate from the cash flows: exact when there are no payments, otherwise the root nearest zero of the
+// quadratic expansion of the equation around i = 0 (the linear one when the quadratic has no real root)
+static double analyticInterestGuess(double pv, double fv, double pmt, double n)
+{
+    if (pmt == 0 && pv != 0 && -fv / pv > 0) return std::pow(-fv / pv, 1 / n) - 1;
+    const double constant = pv + pmt * n + fv;
+    const double linear = pv * n + pmt * n * (n - 1) / 2;
+    const double quadratic = pv * n * (n - 1) / 2 + pmt * n * (n - 1) * (n - 2) / 6;
+    const double discriminant = linear * linear - 4 * quadratic * constant;
+    if (quadratic != 0 && discriminant >= 0)
+    {
+        // Numerically stable form of the root with the smaller magnitude
+        const double q = -(linear + std::copysign(std::sqrt(discriminant), linear)) / 2;
+        if (q != 0) return constant / q;
+    }
+    if (linear == 0) return std::nan("");
+    return -constant / linear;
+}
+
+// Safeguarded Newton: find a sign change around the starting guess, then take Newton steps that stay inside the
+// bracket and bisect whenever a step would leave it, so the solve cannot diverge once a bracket exists
+double Calculator::solveInterest(double pv, double fv, double pmt, double n, double guess, int& iterations, bool& converged, const Settings& settings) const
+{
+    const double lowestRate = -1 + 1e-10; // (1 + i)^n is undefined at and below i = -1
+    const double highestRate = 1e6;
+    const int maxIterations = 100;
+    iterations = 0;
+    converged = false;
+
+    if (!std::isfinite(guess) || guess <= lowestRate) guess = analyticInterestGuess(pv, fv, pmt, n);
+    if (!std::isfinite(guess) || guess <= lowestRate) guess = settings.initialGuessInterest;
 
-    while (std::fabs(diff) > settingErrorThreshold && iterations < maxIterations)
+    double value, slope;
+    interestEquation(pv, fv, pmt, n, guess, value, slope);
+    if (!std::isfinite(value))
     {
-        double f = -pv * pow(1 + guess, n) - pmt * ((pow(1 + guess, n) - 1) / guess) - fv;
-        double f_prime = -pv * n * pow(1 + guess, n - 1) - pmt * ((guess * n * pow(1 + guess, n - 1) - (pow(1 + guess, n) - 1)) / (guess * guess));
+        // (1 + guess)^n overflowed; restart from the configured guess, then from zero
+        guess = (guess != settings.initialGuessInterest) ? settings.initialGuessInterest : 0;
+        interestEquation(pv, fv, pmt, n, guess, value, slope);
+        if (!std::isfinite(value))
+        {
+            guess = 0;
+            interestEquation(pv, fv, pmt, n, guess, value, slope);
+        }
+    }
+    if (value == 0)
+    {
+        converged = true;
+        return guess;
+    }
 
-        newGuess = guess - f / f_prime;
-        diff = newGuess - guess;
-        guess = newGuess;
+    // Expand outward from the guess until the equation changes sign; a side stops growing once (1 + i)^n overflows
+    double left = guess, leftValue = value;
+    double right = guess, rightValue = value;
+    double step = 0.01 + 0.1 * std::fabs(guess);
+    double upperLimit = highestRate;
+    bool bracketed = false;
+    for (int expansion = 0; expansion < 64 && !bracketed; expansion++)
+    {
+        if (right < upperLimit)
+        {
+            const double next = (right + step < upperLimit) ? right + step : upperLimit;
+            double nextValue;
+            interestEquation(pv, fv, pmt, n, next, nextValue, slope);
+            if (!std::isfinite(nextValue))
+            {
+                upperLimit = next;
+            }
+            else if ((nextValue < 0) != (rightValue < 0))
+            {
+                left = right; leftValue = rightValue;
+                right = next; rightValue = nextValue;
+                bracketed = true;
+                break;
+            }
+            else
+            {
+                right = next; rightValue = nextValue;
+            }
+        }
+        if (left > lowestRate)
+        {
+            const double next = (left - step > lowestRate) ? left - step : lowestRate;
+            double nextValue;
+            interestEquation(pv, fv, pmt, n, next, nextValue, slope);
+            if (!std::isfinite(nextValue)) break;
+            if ((nextValue < 0) != (leftValue < 0))
+            {
+                right = left; rightValue = leftValue;
+                left = next; leftValue = nextValue;
+                bracketed = true;
+                break;
+            }
+            left = next; leftValue = nextValue;
+        }
+        step *= 2;
+    }
+    if (!bracketed) return guess; // No sign change anywhere in (-1, highestRate]: there is no rate to find
+
+    double rate = (guess >= left && guess <= right) ? guess : (left + right) / 2; // The guess is usually a bracket end
+    double previousChange = right - left;
+    while (iterations < maxIterations)
+    {
         iterations++;
+        interestEquation(pv, fv, pmt, n, rate, value, slope);
+        if (value == 0)
+        {
+            converged = true;
+            return rate;
+        }
+        // Shrink the bracket around the root
+        if ((value < 0) == (leftValue < 0))
+        {
+            left = rate; leftValue = value;
+        }
+        else
+        {
+            right = rate; rightValue = value;
+        }
+
+        // Bisect when the Newton step leaves the bracket (also catches slope == 0 and NaN) or is not at least
+        // halving the step before it, which is what keeps the iteration count bounded. A step within errorThreshold
+        // is the answer: at the root value is rounding noise, and the step may round to rate itself, a bracket end.
+        double next = rate - value / slope;
+        const bool newtonConverged = std::fabs(next - rate) <= settings.errorThreshold;
+        if (!newtonConverged && (!(next > left && next < right) || std::fabs(2 * value) > std::fabs(previousChange * slope)))
+        {
+            next = (left + right) / 2;
+        }
+        const double change = next - rate;
+        previousChange = change;
+        rate = next;
+        if (std::fabs(change) <= settings.errorThreshold || right - left <= settings.errorThreshold)
+        {
+            converged = true;
+            return rate;
+        }
     }
+    return rate;
+}
 
-    if (iterations >= maxIterations)
+// Interest rate calculation using safeguarded Newton-Raphson
+double Calculator::calculateInterest(double pv, double fv, double pmt, double n, int* iterations, double warmStartGuess) const
+{
+    if (n <= 0) throw std::invalid_argument("Number of periods must be greater than zero.");
+
+    int iterationCount;
+    bool converged;
+    double rate = solveInterest(pv, fv, pmt, n, warmStartGuess, iterationCount, converged, getSettings());
+    if (iterations != nullptr) *iterations = iterationCount;
+    CALCULATOR_METRICS_COUNT(metrics, COUNTER_INTEREST_ITERATIONS, iterationCount);
+    CALCULATOR_METRICS_COUNT(metrics, COUNTER_INTEREST_NOT_CONVERGED, converged ? 0 : 1);
+
+    if (!converged)
         throw std::runtime_error("Interest rate calculation did not converge.");
 
-    return guess;
+    return rate;
 }
 
-// Number of Period calculation using Newton-Raphson
-double Calculator::calculateNumberOfPeriods(double pv, double fv, double pmt, double i) const
+void Calculator::calculateInterestBatch(const double* pv, const double* fv, const double* pmt, const double* n, double* out, size_t count, bool warmStart, int* iterations) const
 {
-    if (i <= 0) throw std::invalid_argument("Interest rate must be greater than zero.");
+    const Settings settings = getSettings();
+    double previousRate = std::nan(""); // Seed for the next row when warm starting
+    uint64_t totalIterations = 0, notConverged = 0; // Reported once for the whole batch
+    for (size_t row = 0; row < count; row++)
+    {
+        int iterationCount = 0;
+        bool converged = false;
+        double rate = std::nan("");
+        if (n[row] > 0)
+        {
+            rate = solveInterest(pv[row], fv[row], pmt[row], n[row], warmStart ? previousRate : std::nan(""), iterationCount, converged, settings);
+        }
+        out[row] = converged ? rate : std::nan("");
+        if (iterations != nullptr) iterations[row] = iterationCount;
+        if (converged) previousRate = rate;
+        totalIterations += iterationCount;
+        notConverged += (n[row] > 0 && !converged) ? 1 : 0;
+    }
+    CALCULATOR_METRICS_COUNT(metrics, COUNTER_INTEREST_ITERATIONS, totalIterations);
+    CALCULATOR_METRICS_COUNT(metrics, COUNTER_INTEREST_NOT_CONVERGED, notConverged);
+}
 
-    double guess = settingInitialGuessPeriods;
+/*
+Number of Periods Solver
+*/
+// Solving pv*(1+i)^N + pmt*((1+i)^N - 1)/i + fv = 0 for (1+i)^N gives (pmt - fv*i) / (pv*i + pmt), so
+// N = log of that over log(1+i). Returns NaN when that ratio is not a positive finite number.
+static double closedFormPeriods(double pv, double fv, double pmt, double i)
+{
+    const double growth = (pmt - fv * i) / (pv * i + pmt);
+    if (!(growth > 0) || !std::isfinite(growth)) return std::nan("");
+    return std::log(growth) / std::log1p(i);
+}
+
+// Newton-Raphson on N, kept for sign combinations the closed form cannot take; the slope comes from a Dual in N
+bool Calculator::solvePeriodsIteratively(double pv, double fv, double pmt, double i, double& periods, const Settings& settings) const
+{
+    double guess = settings.initialGuessPeriods;
     double diff = 1;
     double newGuess;
     int iterations = 0;
     int maxIterations = 1000;
 
-    while (std::fabs(diff) > settingErrorThreshold && iterations < maxIterations)
+    while (std::fabs(diff) > settings.errorThreshold && iterations < maxIterations)
     {
-        double f = -pv * pow(1 + i, guess) - pmt * ((pow(1 + i, guess) - 1) / i) - fv;
-        double f_prime = -pv * log(1 + i) * pow(1 + i, guess) - pmt * pow(1 + i, guess) * log(1 + i) / i;
+        const Dual<1> growth = pow(1 + i, Dual<1>::variable(guess, 0));
+        const Dual<1> f = -pv * growth - pmt * ((growth - 1) / i) - fv;
 
-        newGuess = guess - f / f_prime;
+        newGuess = guess - f.value / f.gradient[0];
         diff = newGuess - guess;
         guess = newGuess;
         iterations++;
     }
 
-    if (iterations == maxIterations)
+    periods = guess;
+    const bool converged = iterations < maxIterations && std::isfinite(guess);
+    CALCULATOR_METRICS_COUNT(metrics, COUNTER_PERIODS_ITERATIONS, iterations);
+    CALCULATOR_METRICS_COUNT(metrics, COUNTER_PERIODS_NOT_CONVERGED, converged ? 0 : 1);
+    return converged;
+}
+
+// Number of Period calculation: closed form, Newton-Raphson only for degenerate inputs
+double Calculator::calculateNumberOfPeriods(double pv, double fv, double pmt, double i) const
+{
+    if (i <= 0) throw std::invalid_argument("Interest rate must be greater than zero.");
+
+    double periods = closedFormPeriods(pv, fv, pmt, i);
+    if (std::isnan(periods) && !solvePeriodsIteratively(pv, fv, pmt, i, periods, getSettings()))
         throw std::runtime_error("Number of periods calculation did not converge.");
 
-    return guess;
+    return periods;
+}
+
+void Calculator::calculateNumberOfPeriodsBatch(const double* pv, const double* fv, const double* pmt, const double* i, double* out, size_t count) const
+{
+    const Settings settings = getSettings();
+
+    // Straight-line closed form first so it vectorizes, then the rare degenerate rows
+    for (size_t row = 0; row < count; row++)
+    {
+        out[row] = (i[row] > 0) ? closedFormPeriods(pv[row], fv[row], pmt[row], i[row]) : std::nan("");
+    }
+    for (size_t row = 0; row < count; row++)
+    {
+        if (std::isnan(out[row]) && i[row] > 0)
+        {
+            double periods;
+            out[row] = solvePeriodsIteratively(pv[row], fv[row], pmt[row], i[row], periods, settings) ? periods : std::nan("");
+        }
+    }
+}
+
+
+/*-----------
+Result Cache
+------------*/
+void Calculator::enableResultCache(size_t capacity)
+{
+    // Evaluations in flight keep the cache they loaded until they finish
+    std::atomic_store(&resultCache, (capacity > 0) ? std::make_shared<ResultCache>(capacity) : std::shared_ptr<ResultCache>());
 }
 
+void Calculator::clearResultCache() const
+{
+    const std::shared_ptr<ResultCache> cache = std::atomic_load(&resultCache);
+    if (cache) cache->clear();
+}
+
+ResultCacheStats Calculator::getResultCacheStats() const
+{
+    const std::shared_ptr<ResultCache> cache = std::atomic_load(&resultCache);
+    return cache ? cache->getStats() : ResultCacheStats{0, 0, 0, 0, 0};
+}
+
+// Appends the raw bytes of a value to a cache key
+template <class Field>
+static void appendKeyField(std::string& key, Field field)
+{
+    key.append(reinterpret_cast<const char*>(&field), sizeof(field));
+}
+
+std::string Calculator::resultCacheKey(const std::vector<Calculator::Token>& tokens, const double* variableValues, const Settings& settings) const
+{
+    // Spacing, literal spelling ("2" vs "2.0", "pi") and variable names normalize away: literals and variables
+    // contribute their value, everything else its opcode (and functions their argument count)
+    std::string key;
+    key.reserve(tokens.size() * (1 + sizeof(double)) + 16);
+    for (const Token& token : tokens)
+    {
+        key += static_cast<char>(token.opcode);
+        if (token.opcode == OP_NUMBER) appendKeyField(key, token.number);
+        else if (token.opcode == OP_VARIABLE) appendKeyField(key, variableValues[token.slot]);
+        else if (token.type == FUNCTION) appendKeyField(key, token.slot); // Argument count of min and max
+    }
+    appendKeyField(key, settings.radianMode);
+    appendKeyField(key, settings.taylorTerms);
+    appendKeyField(key, settings.errorThreshold);
+    return key;
+}
+
+/*------
+Metrics
+-------*/
+MetricsSnapshot Calculator::getMetrics() const
+{
+    if (metrics) return metrics->snapshot();
+    MetricsSnapshot snapshot;
+    std::memset(&snapshot, 0, sizeof(snapshot)); // enabled = false
+    return snapshot;
+}
+
+void Calculator::resetMetrics() const
+{
+    if (metrics) metrics->reset();
+}
+
+void Calculator::exportMetrics(const std::string& filename) const
+{
+    std::ofstream outFile(filename, std::ios::trunc);
+    if (!outFile.is_open()) throw std::runtime_error("Failed to open metrics file.");
+    outFile << getMetrics().toPrometheus();
+    if (!outFile) throw std::runtime_error("Failed to write metrics file.");
+}
+
+/*-------
+History
+--------*/
+void Calculator::configureHistory(const std::string& filename, HistoryFormat format, size_t batchSize, std::chrono::milliseconds flushInterval)
+{
+    // Records already queued on the previous writer are flushed when its last user releases it
+    std::atomic_store(&historyWriter, std::make_shared<HistoryWriter>(filename, format, batchSize, flushInterval));
+}
+
+void Calculator::flushHistory() const
+{
+    std::atomic_load(&historyWriter)->flush();
+}
 
 void Calculator::saveHistory(const std::string& inputExpression, 
-                              const std::vector<Calculator::Token>& tokens, 
                               const std::vector<Calculator::Token>& rpnExpression, 
-                              const std::string& filename, 
-                              double result) const
+                              const std::vector<std::string>& variableNames, 
+                              const double* variableValues,
+                              double result,
+                              const Settings& settings) const
 {
-    std::ofstream outFile(filename, std::ios::app);
-    if (!outFile.is_open())
+    // One load: configureHistory may swap the writer meanwhile, the record goes to the one loaded here
+    const std::shared_ptr<HistoryWriter> writer = std::atomic_load(&historyWriter);
+    HistoryRecord record;
+    if (writer->getFormat() == HISTORY_BINARY)
     {
-        throw std::runtime_error("Failed to open history file.");
+        // Everything needed to replay the evaluation; the writer thread encodes it
+        record.expression = inputExpression;
+        record.variableNames = variableNames;
+        record.variableValues.assign(variableValues, variableValues + variableNames.size());
+        record.result = result;
+        record.radianMode = settings.radianMode;
+        record.taylorTerms = settings.taylorTerms;
+        record.errorThreshold = settings.errorThreshold;
+        writer->append(std::move(record));
+        return;
     }
 
-    outFile << "Expression: " << inputExpression << "\n";
-    outFile << "Tokens: ";
+    // Format on the caller's thread, the writer thread only does the I/O. The parser goes straight to RPN, so the
+    // token list is rebuilt for the record; the expression already parsed, so this cannot fail.
+    const std::vector<Token> tokens = tokenize(inputExpression, variableNames);
+    std::string& text = record.text;
+    text.reserve(64 + inputExpression.length() + 8 * (tokens.size() + rpnExpression.size()));
+    text += "Expression: ";
+    text += inputExpression;
+    text += "\nTokens: ";
     for (const Token& token : tokens)
     {
-        outFile << token.value << " ";
+        text += tokenText(token, variableNames);
+        text += ' ';
     }
-    outFile << "\nRPN: ";
+    text += "\nRPN: ";
     for (const Token& token : rpnExpression)
     {
-        outFile << token.value << " ";
+        text += tokenText(token, variableNames);
+        text += ' ';
     }
-    outFile << "\nResult: " << result << "\n\n";
+    text += "\nResult: ";
+    text += formatNumber(result);
+    text += "\n\n";
 
-    outFile.close();
+    writer->append(std::move(record));
 }
+
+/*----------------
+Dual Instantiations
+-----------------*/
+// The Dual forms are defined in this file, so the sizes the header promises are compiled here
+#define CALCULATOR_INSTANTIATE_DUAL(Inputs, Order) \
+    template Dual<Inputs, Order> Calculator::evaluate(const CompiledExpression&, const Dual<Inputs, Order>*) const; \
+    template Dual<Inputs, Order> Calculator::calculateFV(const Dual<Inputs, Order>&, const Dual<Inputs, Order>&, const Dual<Inputs, Order>&, const Dual<Inputs, Order>&) const; \
+    template Dual<Inputs, Order> Calculator::calculatePV(const Dual<Inputs, Order>&, const Dual<Inputs, Order>&, const Dual<Inputs, Order>&, const Dual<Inputs, Order>&) const; \
+    template Dual<Inputs, Order> Calculator::calculatePMT(const Dual<Inputs, Order>&, const Dual<Inputs, Order>&, const Dual<Inputs, Order>&, const Dual<Inputs, Order>&) const;
+CALCULATOR_INSTANTIATE_DUAL(1, 1)
+CALCULATOR_INSTANTIATE_DUAL(2, 1)
+CALCULATOR_INSTANTIATE_DUAL(3, 1)
+CALCULATOR_INSTANTIATE_DUAL(4, 1)
+CALCULATOR_INSTANTIATE_DUAL(1, 2)
+CALCULATOR_INSTANTIATE_DUAL(2, 2)
+CALCULATOR_INSTANTIATE_DUAL(3, 2)
+CALCULATOR_INSTANTIATE_DUAL(4, 2)
+#undef CALCULATOR_INSTANTIATE_DUAL
@@ -1,75 +1,469 @@
 #ifndef CALCULATOR_H
 #define CALCULATOR_H
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "ConstExpression.h"
+#include "Dual.h"
+#include "HistoryWriter.h"
+#include "Metrics.h"
+#include "ResultCache.h"
+
+class NativeProgram;
+
 class Calculator
 {
 public: 
     // Settings
-    bool settingRadianMode;
-    bool settingSaveHistory;
-    int settingTaylorTerms;
-    double settingInitialGuessInterest;
-    double settingInitialGuessPeriods;
-    double settingErrorThreshold;
+    struct Settings
+    {
+        bool radianMode;
+        bool saveHistory;
+        int taylorTerms;
+        double initialGuessInterest;
+        double initialGuessPeriods;
+        double errorThreshold;
+    };
     // Constructor with defaults
     Calculator(bool radianMode = true, bool saveHistory = false, int taylorTerms = 10, double initialGuessInterest = .05, double initialGuessPeriods = 10, double errorThreshold = 1e-10);
 
-    double evaluateExpression(const std::string& inputExpression) const; // tokenize -> convertToRPN -> evaluateRPN
+    // Settings are immutable snapshots: getSettings() copies out the current one, while every change publishes a new
+    // one. Each evaluation reads one snapshot from start to finish, so one Calculator can be shared by any number of
+    // threads and settings changes never tear an evaluation in flight.
+    Settings getSettings() const;
+    void updateSettings(const std::function<void(Settings&)>& change); // Atomic read-modify-write of the settings
+    void setRadianMode(bool radianMode);
+    void setSaveHistory(bool saveHistory);
+    void setTaylorTerms(int taylorTerms);
+    void setInitialGuessInterest(double initialGuessInterest);
+    void setInitialGuessPeriods(double initialGuessPeriods);
+    void setErrorThreshold(double errorThreshold);
+
+    // Expressions: numbers (1.5, 2e-3), pi, variables, + - * / ^, unary minus, parentheses, the functions sin cos tan
+    // asin acos atan (degrees unless radianMode), exp ln log sqrt abs sinh cosh tanh, and pow(a, b), min(a, ...), max(a, ...)
+    double evaluateExpression(const std::string& inputExpression) const; // parseToRPN -> evaluateRPN
+    // Variables: identifiers listed in variableNames are bound by position to variableValues
+    double evaluateExpression(const std::string& inputExpression, const std::vector<std::string>& variableNames, const std::vector<double>& variableValues) const;
+
+    // Compile once, evaluate many: compile() runs parseToRPN, folds constant subexpressions and removes exact
+    // identities (x*1, x-0, --x), validating the program once, so results match evaluateExpression bit for bit;
+    // evaluate() runs the finished RPN program with no re-parsing and no heap allocation
+    // Each name in variableNames is resolved to its index (slot) at compile time, evaluate() reads variableValues[slot]
+    class CompiledExpression;
+    CompiledExpression compile(const std::string& inputExpression, const std::vector<std::string>& variableNames = {}) const;
+    double evaluate(const CompiledExpression& expression, const double* variableValues = nullptr) const;
+    // Derivatives in one pass (see Dual.h): variableValues holds a Dual per slot, Dual::variable for the inputs to
+    // differentiate by and plain values for the rest. The value is evaluate()'s, with the same errors; the derivatives
+    // come from the chain rule through every operation and function. Compiled for 1 to 4 inputs, Order 1 and 2.
+    template <int Inputs, int Order>
+    Dual<Inputs, Order> evaluate(const CompiledExpression& expression, const Dual<Inputs, Order>* variableValues) const;
+    // Same as compile(), additionally translating the program to x86-64 machine code that evaluate() and tryEvaluate()
+    // then run instead of the interpreter. Where no native backend is available the result is an ordinary compiled
+    // expression (see CompiledExpression::isNative()).
+    CompiledExpression compileNative(const std::string& inputExpression, const std::vector<std::string>& variableNames = {}) const;
+
+    // Compile-time expressions (see ConstExpression.h). constEval parses and evaluates during compilation when called
+    // in a constant expression, constexpr double growth = constEval("2*pi*(1+0.05)^10"), under the default settings
+    // or the radianMode, taylorTerms and errorThreshold of the given ones; a malformed expression is a compile error.
+    static constexpr double constEval(const char* expression) { return constEval(expression, Settings{true, false, 10, .05, 10, 1e-10}); }
+    static constexpr double constEval(const char* expression, const Settings& settings)
+    {
+        return ConstExpression::evaluate(ConstExpression::compile(expression), nullptr, settings.radianMode, settings.taylorTerms, settings.errorThreshold);
+    }
+    // Runs a program ConstExpression::compile built at compile time on runtime variable values, under this
+    // Calculator's settings: the program unrolls into straight-line code, no parsing or dispatch is left at run time.
+    //     static constexpr ConstExpression::Program payment = ConstExpression::compile("x*r/(1-(1+r)^-n)", names);
+    //     calculator.evaluate<payment>(values);
+    template <const ConstExpression::Program& Program>
+    double evaluate(const double* variableValues = nullptr) const;
+
+    // Outcome of an evaluation: per row for batch evaluation, per item for evaluateAll, per call for tryEvaluate
+    enum EvalStatus : unsigned char
+    {
+        EVAL_OK,
+        EVAL_DIVISION_BY_ZERO,
+        EVAL_TAN_UNDEFINED,
+        EVAL_DOMAIN_ERROR, // ln, log, sqrt, asin or acos of an argument outside their domain
+        EVAL_INVALID_EXPRESSION,
+        // Parse errors, reported with the position of the offending text
+        EVAL_INVALID_NUMBER,
+        EVAL_MULTIPLE_DECIMAL_POINTS,
+        EVAL_UNKNOWN_NAME,
+        EVAL_UNKNOWN_CHARACTER,
+        EVAL_MISSING_LEFT_PAREN,
+        EVAL_MISSING_RIGHT_PAREN,
+        EVAL_MISSING_OPERAND,
+        EVAL_EXTRA_OPERAND,
+        EVAL_ARGUMENT_COUNT, // Wrong number of arguments to a function, reported at its name
+        EVAL_MISSING_VALUES // Fewer values than variables
+    };
+
+    // Non-throwing evaluation: every user error comes back as a status instead of an exception, so malformed input
+    // costs no unwinding. The throwing evaluateExpression/evaluate are thin wrappers over these.
+    struct EvalOutcome
+    {
+        double value;      // NaN unless status is EVAL_OK
+        EvalStatus status;
+        size_t position;   // Parse errors: offset of the offending text in the input (its length when at the end)
+        size_t length;     // and its length, 0 when the error is not tied to a piece of text
+    };
+    EvalOutcome tryEvaluate(const std::string& inputExpression) const;
+    EvalOutcome tryEvaluate(const std::string& inputExpression, const std::vector<std::string>& variableNames, const std::vector<double>& variableValues) const;
+    EvalOutcome tryEvaluate(const CompiledExpression& expression, const double* variableValues = nullptr) const;
+    // Message for an outcome, the same text the throwing API would use
+    static std::string describeError(const EvalOutcome& outcome, const std::string& inputExpression);
+
+    // Batch (columnar) evaluation: evaluates one compiled expression over count rows, one opcode at a time across
+    // a block of rows so the inner loops vectorize. variableColumns[slot] points to the count values of that variable.
+    // Rows that fail get NaN in results and their error in status (optional), the rest of the batch still completes.
+    void evaluateBatch(const CompiledExpression& expression, const double* const* variableColumns, size_t count, double* results, EvalStatus* status = nullptr) const;
+    // Single variable form: x holds the values of slot 0
+    void evaluateBatch(const CompiledExpression& expression, const double* x, size_t count, double* results, EvalStatus* status = nullptr) const;
+
+    // Outcome of one expression in evaluateAll
+    struct EvalResult
+    {
+        double value;      // NaN unless status is EVAL_OK
+        EvalStatus status;
+        std::string error; // Error message, empty on success
+    };
+
+    // Parallel evaluation of many independent expressions: parseToRPN -> evaluate runs on the shared
+    // work-stealing ThreadPool, each thread reusing its own token, RPN and stack buffers. Results come back in input
+    // order with a per item status instead of exceptions; one settings snapshot covers the whole call.
+    // threads > 0 caps the threads of the shared pool working on it, the caller included (1 evaluates on the calling
+    // thread alone); 0 uses all of them, one per core.
+    std::vector<EvalResult> evaluateAll(const std::vector<std::string>& expressions, unsigned threads = 0) const;
+    // Streaming form: reads input one expression per line, evaluates chunkSize lines at a time in parallel and hands
+    // every result to sink in input order. Returns the number of lines evaluated.
+    size_t evaluateStream(std::istream& input, const std::function<void(const EvalResult&)>& sink, size_t chunkSize = 16384) const;
+
+    // History (Settings::saveHistory): records go to "calculation_history.txt" through a background writer that keeps the
+    // file open and flushes every batchSize records or flushInterval, and on destruction.
+    // HISTORY_BINARY files store the expression, variables, result and settings of each evaluation; read them back
+    // with HistoryReader. Safe while other threads evaluate: records saved before the switch go to the previous file.
+    // A file that cannot be opened or written never fails tryEvaluate or evaluateAll, its records are dropped;
+    // evaluateExpression and flushHistory report it as std::runtime_error.
+    void configureHistory(const std::string& filename, HistoryFormat format = HISTORY_TEXT, size_t batchSize = 64, std::chrono::milliseconds flushInterval = std::chrono::milliseconds(100));
+    void flushHistory() const; // Blocks until every saved record is on disk, throws std::runtime_error on failure
+
+    // Result cache (off by default): evaluateExpression remembers up to capacity results, keyed on the parsed
+    // RPN program, the values of the variables it reads and the settings that affect the result (radianMode,
+    // taylorTerms, errorThreshold). A settings change therefore never returns a stale result; entries
+    // for the old settings age out. Copies of this Calculator share the cache, capacity 0 disables it. Safe while
+    // other threads evaluate: evaluations in flight finish on the cache they started with.
+    void enableResultCache(size_t capacity);
+    void clearResultCache() const;
+    ResultCacheStats getResultCacheStats() const;
+
+    // Instrumentation, compiled in with CALCULATOR_METRICS (otherwise the snapshot is empty and nothing is recorded):
+    // latency histograms for parseToRPN, evaluateRPN and saveHistory on the string evaluation paths,
+    // solver iteration and non-convergence counts, cache hits and misses and failed evaluations by EvalStatus.
+    // Copies of this Calculator share the metrics. exportMetrics writes the Prometheus text format, replacing filename.
+    MetricsSnapshot getMetrics() const;
+    void resetMetrics() const;
+    void exportMetrics(const std::string& filename) const;
 
     // Finance Calculator Time Value of Money (TVM) Solver
     // n = number of periods, i = interest rate per period, pv = present value, pmt = payment, fv = future value
     double calculateFV(double pv, double pmt, double i, double n) const;
     double calculatePV(double fv, double pmt, double i, double n) const;
     double calculatePMT(double pv, double fv, double i, double n) const;
-    // uses iterative method with Newton-Raphson formula
-    double calculateInterest(double pv, double fv, double pmt, double n) const; 
+    // Batch forms over struct-of-arrays inputs: out[row] gets the scalar result for that row, (1 + i)^n is computed
+    // once per row. Rows calculatePMT would reject come back as NaN. threads > 1 splits the rows across up to that
+    // many threads of the shared pool, 0 uses all of them (one per core).
+    void calculateFVBatch(const double* pv, const double* pmt, const double* i, const double* n, double* out, size_t count, unsigned threads = 1) const;
+    void calculatePVBatch(const double* fv, const double* pmt, const double* i, const double* n, double* out, size_t count, unsigned threads = 1) const;
+    void calculatePMTBatch(const double* pv, const double* fv, const double* i, const double* n, double* out, size_t count, unsigned threads = 1) const;
+    // Dual forms: the value of the double form plus its derivatives with respect to the arguments passed as
+    // Dual::variable, e.g. d(pv)/di and d2(pv)/di2 for duration, DV01 and convexity in one call instead of two or
+    // three bumped ones. Compiled for 1 to 4 inputs, Order 1 and 2.
+    template <int Inputs, int Order>
+    Dual<Inputs, Order> calculateFV(const Dual<Inputs, Order>& pv, const Dual<Inputs, Order>& pmt, const Dual<Inputs, Order>& i, const Dual<Inputs, Order>& n) const;
+    template <int Inputs, int Order>
+    Dual<Inputs, Order> calculatePV(const Dual<Inputs, Order>& fv, const Dual<Inputs, Order>& pmt, const Dual<Inputs, Order>& i, const Dual<Inputs, Order>& n) const;
+    template <int Inputs, int Order>
+    Dual<Inputs, Order> calculatePMT(const Dual<Inputs, Order>& pv, const Dual<Inputs, Order>& fv, const Dual<Inputs, Order>& i, const Dual<Inputs, Order>& n) const;
+    // Interest rate: Newton-Raphson kept inside a bracket around the root, falling back to bisection, so it cannot
+    // diverge. Starts from warmStartGuess when given, otherwise from an analytic estimate (Settings::initialGuessInterest
+    // only if that estimate is unusable). iterations, when given, receives the number of solver steps taken.
+    double calculateInterest(double pv, double fv, double pmt, double n, int* iterations = nullptr, double warmStartGuess = NAN) const; 
+    // Batch form: rows that fail come back as NaN; warmStart seeds each row from the previous row's solution
+    void calculateInterestBatch(const double* pv, const double* fv, const double* pmt, const double* n, double* out, size_t count, bool warmStart = true, int* iterations = nullptr) const;
+    // Number of periods: closed-form logarithmic solution, Newton-Raphson only when the closed form does not apply
     double calculateNumberOfPeriods(double pv, double fv, double pmt, double i) const;
+    // Batch form: rows that fail come back as NaN
+    void calculateNumberOfPeriodsBatch(const double* pv, const double* fv, const double* pmt, const double* i, double* out, size_t count) const;
 
 private:
-    enum TokenType
+    friend class NativeCompiler;        // Generated code calls back into the trig and other functions
+    friend struct CalculatorBenchAccess; // bench/CalculatorBench.cpp times the pipeline stages one by one
+
+    enum TokenType : unsigned char
     {
         NUMBER,
         OPERATOR,
         FUNCTION,
         LEFT_PAREN,
-        RIGHT_PAREN
+        RIGHT_PAREN,
+        COMMA
     };
 
+    // Operation each token performs, the evaluator dispatches on this instead of comparing strings
+    enum OpCode : unsigned char
+    {
+        OP_NUMBER,
+        OP_VARIABLE,
+        OP_ADD,
+        OP_SUBTRACT,
+        OP_MULTIPLY,
+        OP_DIVIDE,
+        OP_POWER,
+        OP_NEGATE, // Unary minus
+        OP_SIN,
+        OP_COS,
+        OP_TAN,
+        OP_EXP,
+        OP_LN,
+        OP_LOG, // Base 10
+        OP_SQRT,
+        OP_ABS,
+        OP_ASIN,
+        OP_ACOS,
+        OP_ATAN,
+        OP_SINH,
+        OP_COSH,
+        OP_TANH,
+        OP_MIN, // Any number of arguments, the count is the token's slot
+        OP_MAX,
+        OP_LEFT_PAREN,
+        OP_RIGHT_PAREN,
+        OP_COMMA
+    };
+    static_assert(OP_VARIABLE == int(ConstExpression::OP_VARIABLE) && OP_NEGATE == int(ConstExpression::OP_NEGATE) && OP_TAN == int(ConstExpression::OP_TAN) &&
+                  OP_TANH == int(ConstExpression::OP_TANH) && OP_MAX == int(ConstExpression::OP_MAX), "ConstExpression::OpCode must number the operations as OpCode does");
+
     struct Token
     {
         TokenType type;
-        std::string value;        
-        // Constructor initializes token with TokenType and value
-        Token(TokenType type, const std::string& value) : type(type), value(value) {}
+        OpCode opcode;
+        int slot;      // Variable slot of OP_VARIABLE tokens; argument count of functions in the RPN program and of ')'
+        double number; // Literal value, parsed once by tokenize, only used by OP_NUMBER tokens
+        // Constructor initializes token with TokenType, OpCode, literal value and variable slot
+        Token(TokenType type, OpCode opcode, double number = 0, int slot = 0) : type(type), opcode(opcode), slot(slot), number(number) {}
     };
 
+    // Built-in functions: pow(a, b) is a ^ b, the rest have opcodes of their own
+    struct FunctionInfo
+    {
+        const char* name;
+        OpCode opcode;
+        int minArguments;
+        int maxArguments; // 0: no limit
+    };
+    static const FunctionInfo functions[]; // Ends with a null name
+    static const FunctionInfo* findFunction(const char* word, size_t length); // Null when word is not a function name
+
     // Main Functions to process input expression
-    std::vector<Token> tokenize(const std::string& inputExpression) const; // Converts input string to tokens for Shunting Yard algorith
+    std::vector<Token> tokenize(const std::string& inputExpression, const std::vector<std::string>& variableNames) const; // Converts input string to tokens for Shunting Yard algorith
     std::vector<Token> convertToRPN(const std::vector<Token>& tokenExpression) const; // Shunting Yard algorith to produce Reverse Polish Notation (RPN)
-    double evaluateRPN(const std::vector<Token>& rpnExpression) const; // Evaluates the Reverse Polish Notation expression
+    // Same stages writing into caller owned vectors, so batch evaluation reuses their capacity
+    void tokenize(const std::string& inputExpression, const std::vector<std::string>& variableNames, std::vector<Token>& tokens) const;
+    bool tokenize(const std::string& inputExpression, const std::vector<std::string>& variableNames, std::vector<Token>& tokens, EvalOutcome& error) const; // Non-throwing, false with error filled in
+    struct ParseState; // Grammar state carried from one token to the next
+    bool nextToken(const std::string& inputExpression, const std::vector<std::string>& variableNames, size_t& index,
+                   ParseState& state, Token& token, EvalOutcome& error) const; // One token of tokenize, grammar checked
+    // Fused tokenize + convertToRPN: one scan straight to the RPN program, plus the stack depth it needs
+    bool parseToRPN(const std::string& inputExpression, const std::vector<std::string>& variableNames, std::vector<Token>& program, int& maxDepth, EvalOutcome& error) const;
+    void convertToRPN(const std::vector<Token>& tokenExpression, std::vector<Token>& outputStack, std::vector<Token>& operatorStack) const;
+
+    // Helper Functions for compiled expressions
+    CompiledExpression compileRPN(const std::vector<Token>& rpnExpression) const; // Validates operand counts and measures stack depth
+    // Constant folding and algebraic simplification of a valid RPN program; usedSettings is set when trig was folded
+    // under settings, so the result only holds for them
+    std::vector<Token> optimizeRPN(const std::vector<Token>& rpnExpression, const Settings& settings, bool& usedSettings) const;
+    const CompiledExpression& programFor(const CompiledExpression& expression, const Settings& settings) const; // Folded or unfolded program
+    EvalStatus validateRPN(const std::vector<Token>& rpnExpression, int& maxDepth, int& variableCount) const;
+    // Runs a validated program on a caller supplied stack; reports division by zero, undefined tangents and domain errors instead of throwing
+    EvalStatus evaluateRPN(const std::vector<Token>& rpnExpression, const double* variableValues, double* evalStack, const Settings& settings, double& result) const;
+    template <int Inputs, int Order> // Same on Dual values
+    EvalStatus evaluateRPN(const std::vector<Token>& rpnExpression, const Dual<Inputs, Order>* variableValues, Dual<Inputs, Order>* evalStack, const Settings& settings, Dual<Inputs, Order>& result) const;
+    double evaluateCompiled(const CompiledExpression& expression, const double* variableValues, const Settings& settings) const; // evaluate() on a given snapshot
+    EvalOutcome tryEvaluateCompiled(const CompiledExpression& expression, const double* variableValues, const Settings& settings) const;
+    [[noreturn]] static void throwEvalError(const EvalOutcome& outcome, const std::string& inputExpression);
+    // evaluate<Program>: one instantiation per instruction, each with its opcode and stack slots fixed
+    template <const ConstExpression::Program& Program, size_t... Steps>
+    void evaluateSteps(const double* variableValues, double* evalStack, const Settings& settings, std::index_sequence<Steps...>) const;
+    template <const ConstExpression::Program& Program, size_t Step>
+    void evaluateStep(const double* variableValues, double* evalStack, const Settings& settings) const;
+
+    // Buffers evaluateAll reuses from one expression to the next, one set per thread
+    struct EvalScratch
+    {
+        std::vector<Token> tokens;
+        std::vector<Token> outputStack;
+        std::vector<Token> operatorStack;
+        std::vector<double> evalStack;
+    };
+    static EvalScratch& threadScratch();
+    void evaluateItem(const std::string& expression, const Settings& settings, EvalScratch& scratch, EvalResult& result) const;
+    // parseToRPN -> (result cache) -> evaluateRPN -> (history) on one snapshot and one set of buffers
+    EvalOutcome evaluatePipeline(const std::string& inputExpression, const std::vector<std::string>& variableNames, const double* variableValues,
+                                 const Settings& settings, EvalScratch& scratch, bool useCache) const;
 
     // Helper Functions to process input expression
-    bool isLeftAssociative(const std::string& op) const;
-    int getPrecedence(const std::string& op) const;
+    bool isLeftAssociative(OpCode op) const;
+    int getPrecedence(OpCode op) const;
+    std::string tokenText(const Token& token, const std::vector<std::string>& variableNames) const; // Printable form of a token for the history file
+    std::string resultCacheKey(const std::vector<Token>& tokens, const double* variableValues, const Settings& settings) const; // Normalized RPN program, variable values and settings
 
     // Trigonometric and Mathematical Helper Functions
-    double factorial(const int n) const;
-    double reduceAngle(const double angle) const;  // Reduces angle to [-π, π] range
+    double reduceAngle(const double angle, int& quadrant) const;  // Reduces angle to [-π/4, π/4] range plus quadrant, in constant time
+    double toReducedRadians(const double angle, int& quadrant, const Settings& settings) const; // Applies radianMode then reduceAngle
+    int taylorTermsUsed(const Settings& settings) const; // taylorTerms capped at the size of the coefficient tables
     
     // Trigonometric Functions using Taylor Series approximation
-    double calcSin(const double angle) const;  
-    double calcCos(const double angle) const;  
-    double calcTan(const double angle) const;  
+    double calcSin(const double angle, const Settings& settings) const;  
+    double calcCos(const double angle, const Settings& settings) const;  
+    double calcTan(const double angle, const Settings& settings) const;  
+    void calcSinCos(const double angle, double& sinValue, double& cosValue, const Settings& settings) const; // Both series from one reduction
+    void calcSinCosBlock(const double* angles, double* sinValues, double* cosValues, size_t count, const Settings& settings) const; // Vectorized form for batches
+
+    // The unary functions past tan (exp .. tanh) on MathKernels, under the settings: arguments within errorThreshold
+    // of the domain are clamped onto it, inverse trig answers in degrees unless radianMode and results within
+    // errorThreshold of zero become 0, as with calcSin
+    EvalStatus applyFunction(OpCode function, double& value, const Settings& settings) const;
+    void applyFunctionBlock(OpCode function, double* values, unsigned char* rowStatus, size_t count, const Settings& settings) const; // Flags rows in rowStatus
+    static bool clampToDomain(OpCode function, double& value, double errorThreshold); // False when value is outside the domain
+    static double adjustResult(OpCode function, double value, const Settings& settings);
+    // First and second derivative of a function at x, a value clampToDomain accepted, in the unit adjustResult gives
+    static void functionDerivatives(OpCode function, double x, const Settings& settings, double& first, double& second);
 
-    // Save history to a file
+    // TVM solver helpers
+    double solveInterest(double pv, double fv, double pmt, double n, double guess, int& iterations, bool& converged, const Settings& settings) const;
+    bool solvePeriodsIteratively(double pv, double fv, double pmt, double i, double& periods, const Settings& settings) const;
+
+    // Save history to a file, queued on historyWriter so the caller never waits on disk
     void saveHistory(const std::string& inputExpression, 
-                     const std::vector<Token>& tokens, 
                      const std::vector<Token>& rpnExpression, 
-                     const std::string& filename, 
-                     double result) const;
+                     const std::vector<std::string>& variableNames, 
+                     const double* variableValues,
+                     double result,
+                     const Settings& settings) const;
+
+    // Copy-on-write holder of the current settings. Readers take the current snapshot with std::atomic_load, like
+    // historyWriter; writers serialize on a mutex and publish a new snapshot with std::atomic_store. A replaced
+    // snapshot is freed once the last reader holding it lets go.
+    class SettingsStore
+    {
+    public:
+        explicit SettingsStore(const Settings& initial);
+        SettingsStore(const SettingsStore& other); // Copies start from the other store's current snapshot
+        SettingsStore& operator=(const SettingsStore& other);
+
+        std::shared_ptr<const Settings> load() const { return std::atomic_load(&current); }
+        void update(const std::function<void(Settings&)>& change);
+
+    private:
+        void publish(const Settings& settings);
+
+        std::shared_ptr<const Settings> current;
+        std::mutex writeMutex;
+    };
+
+    SettingsStore settingsStore;
+    // Swapped by configureHistory and enableResultCache while other threads may be evaluating, so every access
+    // goes through std::atomic_load/std::atomic_store
+    std::shared_ptr<HistoryWriter> historyWriter; // Shared by copies of this Calculator
+    std::shared_ptr<ResultCache> resultCache;     // Null while the cache is disabled
+    std::shared_ptr<Metrics> metrics;             // Null unless built with CALCULATOR_METRICS
 };
 
+class Calculator::CompiledExpression
+{
+public:
+    CompiledExpression() : maxStackDepth(0), variableCount(0), foldedRadianMode(false), foldedTaylorTerms(0), foldedErrorThreshold(0) {}
+
+    int getVariableCount() const { return variableCount; } // Number of variable slots evaluate() reads
+    bool isNative() const { return native != nullptr; }     // Runs as machine code rather than through evaluateRPN
+
+private:
+    friend class Calculator;
+    std::vector<Calculator::Token> rpnProgram; // Validated, optimized RPN program
+    int maxStackDepth;                         // Deepest evaluation stack the program needs
+    int variableCount;                         // Highest variable slot used + 1
+
+    // Set when folding evaluated trig functions: rpnProgram then only holds for the settings below and evaluation
+    // under any other settings runs the unfolded program instead
+    std::shared_ptr<const CompiledExpression> unfolded;
+    bool foldedRadianMode;
+    int foldedTaylorTerms;
+    double foldedErrorThreshold;
+
+    std::shared_ptr<const NativeProgram> native; // Machine code for rpnProgram, null when interpreted
+};
+
+template <const ConstExpression::Program& Program>
+double Calculator::evaluate(const double* variableValues) const
+{
+    const Settings settings = getSettings();
+    if (Program.variableCount > 0 && variableValues == nullptr) throwEvalError(EvalOutcome{std::nan(""), EVAL_MISSING_VALUES, 0, 0}, "");
+    double evalStack[Program.maxDepth];
+    evaluateSteps<Program>(variableValues, evalStack, settings, std::make_index_sequence<static_cast<size_t>(Program.length)>());
+    // Adjust result close to zero before returning
+    return (std::fabs(evalStack[0]) < settings.errorThreshold) ? 0 : evalStack[0];
+}
+
+template <const ConstExpression::Program& Program, size_t... Steps>
+void Calculator::evaluateSteps(const double* variableValues, double* evalStack, const Settings& settings, std::index_sequence<Steps...>) const
+{
+    (evaluateStep<Program, Steps>(variableValues, evalStack, settings), ...);
+}
+
+// evaluateRPN's case for one instruction, chosen at compile time
+template <const ConstExpression::Program& Program, size_t Step>
+void Calculator::evaluateStep(const double* variableValues, double* evalStack, const Settings& settings) const
+{
+    constexpr ConstExpression::Instruction instruction = Program.instructions[Step];
+    constexpr OpCode opcode = static_cast<OpCode>(instruction.opcode);
+    double& value = evalStack[instruction.top];
+    if constexpr (opcode == OP_NUMBER) value = instruction.number;
+    else if constexpr (opcode == OP_VARIABLE) value = variableValues[instruction.slot];
+    else if constexpr (opcode == OP_ADD) value += evalStack[instruction.top + 1];
+    else if constexpr (opcode == OP_SUBTRACT) value -= evalStack[instruction.top + 1];
+    else if constexpr (opcode == OP_MULTIPLY) value *= evalStack[instruction.top + 1];
+    else if constexpr (opcode == OP_DIVIDE)
+    {
+        if (evalStack[instruction.top + 1] == 0) throwEvalError(EvalOutcome{std::nan(""), EVAL_DIVISION_BY_ZERO, 0, 0}, "");
+        value /= evalStack[instruction.top + 1];
+    }
+    else if constexpr (opcode == OP_POWER) value = std::pow(value, evalStack[instruction.top + 1]);
+    else if constexpr (opcode == OP_NEGATE) value = -value;
+    else if constexpr (opcode == OP_SIN) value = calcSin(value, settings);
+    else if constexpr (opcode == OP_COS) value = calcCos(value, settings);
+    else if constexpr (opcode == OP_TAN) value = calcTan(value, settings);
+    else if constexpr (opcode == OP_MIN || opcode == OP_MAX)
+    {
+        for (int entry = instruction.top + 1; entry < instruction.top + instruction.slot; entry++)
+        {
+            value = (opcode == OP_MIN) ? MathKernels::minimum(value, evalStack[entry]) : MathKernels::maximum(value, evalStack[entry]);
+        }
+    }
+    else
+    {
+        const EvalStatus status = applyFunction(opcode, value, settings);
+        if (status != EVAL_OK) throwEvalError(EvalOutcome{std::nan(""), status, 0, 0}, "");
+    }
+}
+
 #endif
@@ -0,0 +1,664 @@
+#ifndef CONST_EXPRESSION_H
+#define CONST_EXPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "ConstMath.h"
+#include "MathKernels.h"
+
+// Calculator's expression pipeline as constexpr code, for formulas fixed in the source. compile() parses with the
+// grammar, precedence and error rules of parseToRPN into a fixed size Program; evaluate() runs a Program with the
+// operators, trig series, elementary functions and errorThreshold rules of evaluateRPN, on ConstMath, which gives
+// the bits of the run time kernels. Called in a constant expression both run during compilation, and input that
+// evaluateExpression rejects throws there too, which makes it a compile error. The messages are describeError's
+// without the quoted text.
+//
+// Two things differ from evaluateExpression: x^y, where ConstMath::pow and std::pow are both within an ulp of the
+// exact power but now and then round to different neighbours, and tan where the cosine is exactly 0 (errorThreshold
+// <= 0 only), which is an error here rather than an infinity.
+class ConstExpression
+{
+public:
+    static constexpr int maxInstructions = 128; // Longer programs do not compile
+    static constexpr int maxNesting = 64;       // Open parentheses and pending operators
+
+    // Numbered as Calculator::OpCode, so Calculator runs a Program's instructions as its own
+    enum OpCode : unsigned char
+    {
+        OP_NUMBER,
+        OP_VARIABLE,
+        OP_ADD,
+        OP_SUBTRACT,
+        OP_MULTIPLY,
+        OP_DIVIDE,
+        OP_POWER,
+        OP_NEGATE,
+        OP_SIN,
+        OP_COS,
+        OP_TAN,
+        OP_EXP,
+        OP_LN,
+        OP_LOG,
+        OP_SQRT,
+        OP_ABS,
+        OP_ASIN,
+        OP_ACOS,
+        OP_ATAN,
+        OP_SINH,
+        OP_COSH,
+        OP_TANH,
+        OP_MIN,
+        OP_MAX
+    };
+
+    struct Instruction
+    {
+        OpCode opcode;
+        int slot;      // Variable slot of OP_VARIABLE, argument count of functions
+        int top;       // Stack index the instruction leaves its result at
+        double number; // Value of OP_NUMBER
+    };
+
+    // Validated RPN program; a literal type, so it can be a constexpr object and a template argument
+    struct Program
+    {
+        Instruction instructions[maxInstructions];
+        int length;
+        int maxDepth;      // Deepest evaluation stack the program needs
+        int variableCount; // Highest variable slot used + 1
+    };
+
+    // variableNames are bound to slots by position, as in Calculator::compile
+    static constexpr Program compile(const char* expression) { return compile(expression, nullptr, 0); }
+    template <size_t Count>
+    static constexpr Program compile(const char* expression, const char* const (&variableNames)[Count]) { return compile(expression, variableNames, Count); }
+
+    // Runs program under the settings that affect results; variableValues holds a value for each slot
+    static constexpr double evaluate(const Program& program, const double* variableValues, bool radianMode, int taylorTerms, double errorThreshold)
+    {
+        if (program.variableCount > 0 && variableValues == nullptr) throw std::invalid_argument("Missing values for expression variables");
+        const int terms = (taylorTerms < ConstMath::maxTaylorTerms) ? taylorTerms : ConstMath::maxTaylorTerms;
+        double stack[maxInstructions] = {};
+        for (int index = 0; index < program.length; index++)
+        {
+            const Instruction& instruction = program.instructions[index];
+            double& value = stack[instruction.top];
+            const double operand = (instruction.top + 1 < maxInstructions) ? stack[instruction.top + 1] : 0; // Second operand of binary operators
+            switch (instruction.opcode)
+            {
+                case OP_NUMBER: value = instruction.number; break;
+                case OP_VARIABLE: value = variableValues[instruction.slot]; break;
+                case OP_ADD: value = ConstMath::add(value, operand); break;
+                case OP_SUBTRACT: value = ConstMath::add(value, -operand); break;
+                case OP_MULTIPLY: value = ConstMath::multiply(value, operand); break;
+                case OP_DIVIDE:
+                    if (operand == 0) throw std::runtime_error("Division by zero");
+                    value = ConstMath::divide(value, operand);
+                    break;
+                case OP_POWER: value = ConstMath::pow(value, operand); break;
+                case OP_NEGATE: value = -value; break;
+                case OP_SIN:
+                case OP_COS:
+                {
+                    int quadrant = 0;
+                    const double theta = reduce(value, radianMode, quadrant);
+                    value = (instruction.opcode == OP_SIN) ? ConstMath::sinReduced(theta, quadrant, terms, errorThreshold)
+                                                           : ConstMath::cosReduced(theta, quadrant, terms, errorThreshold);
+                    break;
+                }
+                case OP_TAN: value = tan(value, radianMode, terms, errorThreshold); break;
+                case OP_MIN:
+                case OP_MAX:
+                    for (int entry = instruction.top + 1; entry < instruction.top + instruction.slot; entry++)
+                    {
+                        value = (instruction.opcode == OP_MIN) ? MathKernels::minimum(value, stack[entry]) : MathKernels::maximum(value, stack[entry]);
+                    }
+                    break;
+                default: value = applyFunction(instruction.opcode, value, radianMode, errorThreshold); break;
+            }
+        }
+        return (ConstMath::abs(stack[0]) < errorThreshold) ? 0 : stack[0];
+    }
+
+private:
+    struct FunctionInfo
+    {
+        const char* name;
+        OpCode opcode;
+        int minArguments;
+        int maxArguments; // 0: no limit
+    };
+    static constexpr FunctionInfo functions[] =
+    {
+        {"sin", OP_SIN, 1, 1}, {"cos", OP_COS, 1, 1}, {"tan", OP_TAN, 1, 1},
+        {"asin", OP_ASIN, 1, 1}, {"acos", OP_ACOS, 1, 1}, {"atan", OP_ATAN, 1, 1},
+        {"sinh", OP_SINH, 1, 1}, {"cosh", OP_COSH, 1, 1}, {"tanh", OP_TANH, 1, 1},
+        {"exp", OP_EXP, 1, 1}, {"ln", OP_LN, 1, 1}, {"log", OP_LOG, 1, 1}, {"sqrt", OP_SQRT, 1, 1}, {"abs", OP_ABS, 1, 1},
+        {"pow", OP_POWER, 2, 2}, {"min", OP_MIN, 1, 0}, {"max", OP_MAX, 1, 0}
+    };
+    static constexpr int functionCount = sizeof(functions) / sizeof(functions[0]);
+
+    /*---- Characters ----*/
+    // The C locale classes std::isspace, std::isalpha and std::isalnum use
+    static constexpr bool isSpace(char character) { return character == ' ' || (character >= '\t' && character <= '\r'); }
+    static constexpr bool isDigit(char character) { return character >= '0' && character <= '9'; }
+    static constexpr bool isAlpha(char character) { return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z'); }
+    static constexpr bool isWordCharacter(char character) { return isAlpha(character) || isDigit(character) || character == '_'; }
+
+    static constexpr size_t textLength(const char* text)
+    {
+        size_t length = 0;
+        while (text[length] != '\0') length++;
+        return length;
+    }
+
+    // True when [word, word + length) spells text
+    static constexpr bool wordIs(const char* word, size_t length, const char* text)
+    {
+        for (size_t index = 0; index < length; index++)
+        {
+            if (text[index] != word[index]) return false; // Also stops at the end of a shorter text
+        }
+        return text[length] == '\0';
+    }
+
+    /*---- Parser ----*/
+    // parseToRPN: nextToken's grammar checks and the shunting yard in one pass
+    enum PendingType : unsigned char
+    {
+        PENDING_OPERATOR,
+        PENDING_FUNCTION,
+        PENDING_LEFT_PAREN
+    };
+
+    struct PendingOperator
+    {
+        PendingType type;
+        OpCode opcode;
+    };
+
+    // One open parenthesis
+    struct Group
+    {
+        int function;  // Index in functions of the function whose argument list it opened, -1 for grouping parentheses
+        int arguments; // Commas seen so far + 1
+    };
+
+    static constexpr int precedence(OpCode operation)
+    {
+        switch (operation)
+        {
+            case OP_ADD:
+            case OP_SUBTRACT: return 1;
+            case OP_MULTIPLY:
+            case OP_DIVIDE: return 2;
+            case OP_POWER: return 3;
+            case OP_NEGATE: return 4;
+            default: return 0;
+        }
+    }
+
+    static constexpr void append(Program& program, const Instruction& instruction)
+    {
+        if (program.length == maxInstructions) throw std::invalid_argument("Expression too long for ConstExpression");
+        program.instructions[program.length++] = instruction;
+    }
+
+    // Binary operators pop two operands and push one, functions pop their arguments; pow(a, b) becomes a ^ b
+    static constexpr void emitOperator(Program& program, int& depth, const PendingOperator& operation, int arguments)
+    {
+        const bool function = (operation.type == PENDING_FUNCTION && operation.opcode != OP_POWER);
+        depth -= function ? arguments - 1 : (operation.opcode == OP_NEGATE) ? 0 : 1;
+        append(program, Instruction{operation.opcode, function ? arguments : 0, depth - 1, 0});
+    }
+
+    static constexpr Program compile(const char* expression, const char* const* variableNames, size_t variableCount)
+    {
+        Program program{};
+        PendingOperator operators[maxNesting] = {};
+        Group groups[maxNesting] = {};
+        int operatorCount = 0, groupCount = 0, depth = 0;
+        bool expectNumber = true; // Finite state for detecting unary minus vs. binary subtraction
+        int function = -1;        // Function read by the previous token, a '(' now opens its argument list
+
+        auto pushOperator = [&](PendingType type, OpCode opcode)
+        {
+            if (operatorCount == maxNesting) throw std::invalid_argument("Expression nests too deeply for ConstExpression");
+            operators[operatorCount++] = PendingOperator{type, opcode};
+        };
+        auto pushValue = [&](const Instruction& instruction)
+        {
+            append(program, instruction);
+            if (++depth > program.maxDepth) program.maxDepth = depth;
+        };
+
+        const size_t length = textLength(expression);
+        for (size_t index = 0; index < length; index++)
+        {
+            const char character = expression[index];
+            if (isSpace(character)) continue;
+            const int previousFunction = function;
+            function = -1;
+            // Functions with more than one argument are only written as calls: pow(2, x), not pow 2
+            if (previousFunction >= 0 && functions[previousFunction].maxArguments != 1 && character != '(')
+            {
+                throw std::invalid_argument("Mismatched parenthesis, missing: '('");
+            }
+
+            if (isDigit(character) || character == '.')
+            {
+                if (!expectNumber) throw std::invalid_argument("Invalid expression: too many operands");
+                const double number = scanNumber(expression, length, index);
+                pushValue(Instruction{OP_NUMBER, 0, depth, number});
+                expectNumber = false;
+            }
+            else if (isAlpha(character) || character == '_')
+            {
+                size_t end = index;
+                while (end < length && isWordCharacter(expression[end])) end++;
+                const char* word = expression + index;
+                const size_t wordLength = end - index;
+                index = end - 1;
+                if (!expectNumber) throw std::invalid_argument("Invalid expression: too many operands");
+
+                if (wordIs(word, wordLength, "pi") || wordIs(word, wordLength, "Pi") || wordIs(word, wordLength, "PI"))
+                {
+                    pushValue(Instruction{OP_NUMBER, 0, depth, ConstMath::pi});
+                    expectNumber = false;
+                    continue;
+                }
+                for (int candidate = 0; candidate < functionCount && function < 0; candidate++)
+                {
+                    if (wordIs(word, wordLength, functions[candidate].name)) function = candidate;
+                }
+                if (function >= 0)
+                {
+                    pushOperator(PENDING_FUNCTION, functions[function].opcode);
+                    continue; // expectNumber stays true
+                }
+                size_t slot = 0;
+                while (slot < variableCount && !wordIs(word, wordLength, variableNames[slot])) slot++;
+                if (slot == variableCount) throw std::invalid_argument("Unrecognized function or variable");
+                pushValue(Instruction{OP_VARIABLE, static_cast<int>(slot), depth, 0});
+                if (static_cast<int>(slot) >= program.variableCount) program.variableCount = static_cast<int>(slot) + 1;
+                expectNumber = false;
+            }
+            else if (character == '^' || character == '*' || character == '/' || character == '+' || character == '-')
+            {
+                OpCode operation = OP_NEGATE;
+                if (!(character == '-' && expectNumber))
+                {
+                    if (expectNumber) throw std::invalid_argument("Invalid expression: not enough operands");
+                    operation = (character == '^') ? OP_POWER :
+                                (character == '*') ? OP_MULTIPLY :
+                                (character == '/') ? OP_DIVIDE :
+                                (character == '+') ? OP_ADD : OP_SUBTRACT;
+                }
+                const int operationPrecedence = precedence(operation);
+                const bool leftAssociative = (operation != OP_POWER && operation != OP_NEGATE);
+                while (operatorCount > 0 && operators[operatorCount - 1].type != PENDING_LEFT_PAREN &&
+                       (precedence(operators[operatorCount - 1].opcode) > operationPrecedence ||
+                        (precedence(operators[operatorCount - 1].opcode) == operationPrecedence && leftAssociative)))
+                {
+                    emitOperator(program, depth, operators[--operatorCount], 1);
+                }
+                pushOperator(PENDING_OPERATOR, operation);
+                expectNumber = true;
+            }
+            else if (character == '(')
+            {
+                if (!expectNumber) throw std::invalid_argument("Invalid expression: too many operands");
+                if (groupCount == maxNesting) throw std::invalid_argument("Expression nests too deeply for ConstExpression");
+                groups[groupCount++] = Group{previousFunction, 1};
+                pushOperator(PENDING_LEFT_PAREN, OP_NUMBER);
+            }
+            else if (character == ')' || character == ',')
+            {
+                if (character == ')' && groupCount == 0) throw std::invalid_argument("Mismatched parenthesis, missing: '('");
+                if (expectNumber) throw std::invalid_argument("Invalid expression: not enough operands");
+                Group& group = groups[(groupCount > 0) ? groupCount - 1 : 0];
+                if (character == ',')
+                {
+                    if (groupCount == 0 || group.function < 0) throw std::invalid_argument("Invalid expression: too many operands");
+                    const int maxArguments = functions[group.function].maxArguments;
+                    if (maxArguments != 0 && group.arguments == maxArguments) throw std::invalid_argument("Wrong number of arguments");
+                    group.arguments++;
+                    expectNumber = true;
+                }
+                else if (group.function >= 0 && group.arguments < functions[group.function].minArguments)
+                {
+                    throw std::invalid_argument("Wrong number of arguments");
+                }
+
+                while (operators[operatorCount - 1].type != PENDING_LEFT_PAREN) emitOperator(program, depth, operators[--operatorCount], 1);
+                if (character == ',') continue; // The call's parenthesis stays open for the next argument
+                operatorCount--;
+                groupCount--;
+                // A function applies to the parenthesized arguments that just closed
+                if (operatorCount > 0 && operators[operatorCount - 1].type == PENDING_FUNCTION)
+                {
+                    emitOperator(program, depth, operators[--operatorCount], group.arguments);
+                }
+            }
+            else
+            {
+                throw std::invalid_argument("Unrecognized character");
+            }
+        }
+        if (expectNumber) throw std::invalid_argument("Invalid expression: not enough operands");
+        if (groupCount > 0) throw std::invalid_argument("Mismatched parenthesis, missing: ')'");
+
+        while (operatorCount > 0) emitOperator(program, depth, operators[--operatorCount], 1);
+        return program;
+    }
+
+    /*---- Number literals ----*/
+    // Scans the literal at index as scanNumber does and converts it to the nearest double, as from_chars (and
+    // strtod past the double range) do. index ends on the literal's last character.
+    static constexpr double scanNumber(const char* text, size_t length, size_t& index)
+    {
+        const size_t start = index;
+        bool decimalPoint = false;
+        while (index < length && (isDigit(text[index]) || text[index] == '.'))
+        {
+            if (text[index] == '.')
+            {
+                if (decimalPoint) throw std::invalid_argument("Invalid number format: multiple decimal points");
+                decimalPoint = true;
+            }
+            index++;
+        }
+        const size_t mantissaEnd = index;
+        int64_t exponent = 0;
+        if (index < length && (text[index] == 'e' || text[index] == 'E'))
+        {
+            size_t position = index + 1;
+            const bool negative = (position < length && text[position] == '-');
+            if (position < length && (text[position] == '+' || text[position] == '-')) position++;
+            const size_t digits = position;
+            for (; position < length && isDigit(text[position]); position++)
+            {
+                if (exponent < 100000) exponent = exponent * 10 + (text[position] - '0'); // Far past both ends of the double range
+            }
+            if (position == digits) throw std::invalid_argument("Invalid number format"); // "1e", "2e+"
+            if (negative) exponent = -exponent;
+            index = position;
+        }
+        if (mantissaEnd - start == (decimalPoint ? 1u : 0u)) throw std::invalid_argument("Invalid number format"); // ".", ".e5"
+        index--;
+        return decimalToDouble(text + start, text + mantissaEnd, exponent);
+    }
+
+    static constexpr int maxSignificantDigits = 800; // Every double is exactly determined by its first 767 digits
+    static constexpr int bigNumberLimbs = 128;
+
+    // Unsigned integer of up to 4096 bits, 32 bit limbs, least significant first
+    struct BigNumber
+    {
+        uint32_t limbs[bigNumberLimbs];
+        int count;
+    };
+
+    static constexpr void bigMultiplyAdd(BigNumber& number, uint32_t factor, uint32_t addend)
+    {
+        uint64_t carry = addend;
+        for (int limb = 0; limb < number.count; limb++)
+        {
+            const uint64_t product = static_cast<uint64_t>(number.limbs[limb]) * factor + carry;
+            number.limbs[limb] = static_cast<uint32_t>(product);
+            carry = product >> 32;
+        }
+        if (carry != 0) number.limbs[number.count++] = static_cast<uint32_t>(carry);
+    }
+
+    static constexpr BigNumber bigShiftLeft(const BigNumber& number, int bits)
+    {
+        BigNumber result{};
+        const int limbShift = bits / 32, bitShift = bits % 32;
+        for (int limb = number.count - 1; limb >= 0; limb--)
+        {
+            const uint64_t shifted = static_cast<uint64_t>(number.limbs[limb]) << bitShift;
+            result.limbs[limb + limbShift + 1] |= static_cast<uint32_t>(shifted >> 32);
+            result.limbs[limb + limbShift] |= static_cast<uint32_t>(shifted);
+        }
+        result.count = number.count + limbShift + 1;
+        while (result.count > 0 && result.limbs[result.count - 1] == 0) result.count--;
+        return result;
+    }
+
+    static constexpr void bigShiftRightOne(BigNumber& number)
+    {
+        for (int limb = 0; limb < number.count; limb++)
+        {
+            const uint32_t high = (limb + 1 < number.count) ? number.limbs[limb + 1] : 0;
+            number.limbs[limb] = (number.limbs[limb] >> 1) | (high << 31);
+        }
+        while (number.count > 0 && number.limbs[number.count - 1] == 0) number.count--;
+    }
+
+    static constexpr int bigCompare(const BigNumber& a, const BigNumber& b)
+    {
+        if (a.count != b.count) return (a.count < b.count) ? -1 : 1;
+        for (int limb = a.count - 1; limb >= 0; limb--)
+        {
+            if (a.limbs[limb] != b.limbs[limb]) return (a.limbs[limb] < b.limbs[limb]) ? -1 : 1;
+        }
+        return 0;
+    }
+
+    static constexpr void bigSubtract(BigNumber& a, const BigNumber& b) // a >= b
+    {
+        int64_t borrow = 0;
+        for (int limb = 0; limb < a.count; limb++)
+        {
+            const int64_t difference = static_cast<int64_t>(a.limbs[limb]) - ((limb < b.count) ? b.limbs[limb] : 0) - borrow;
+            borrow = (difference < 0) ? 1 : 0;
+            a.limbs[limb] = static_cast<uint32_t>(difference + (borrow << 32));
+        }
+        while (a.count > 0 && a.limbs[a.count - 1] == 0) a.count--;
+    }
+
+    static constexpr int bigBitLength(const BigNumber& number)
+    {
+        if (number.count == 0) return 0;
+        int bits = (number.count - 1) * 32;
+        for (uint32_t top = number.limbs[number.count - 1]; top != 0; top >>= 1) bits++;
+        return bits;
+    }
+
+    static constexpr BigNumber bigPowerOfTen(int exponent)
+    {
+        BigNumber result{};
+        result.limbs[0] = 1;
+        result.count = 1;
+        for (; exponent >= 9; exponent -= 9) bigMultiplyAdd(result, 1000000000, 0);
+        uint32_t factor = 1;
+        for (; exponent > 0; exponent--) factor *= 10;
+        bigMultiplyAdd(result, factor, 0);
+        return result;
+    }
+
+    // floor(numerator / denominator) for a quotient below 2^62, leaving the remainder in numerator
+    static constexpr uint64_t bigDivide(BigNumber& numerator, const BigNumber& denominator)
+    {
+        uint64_t quotient = 0;
+        BigNumber shifted = bigShiftLeft(denominator, 61);
+        for (int bit = 61; bit >= 0; bit--)
+        {
+            if (bigCompare(numerator, shifted) >= 0)
+            {
+                bigSubtract(numerator, shifted);
+                quotient |= uint64_t(1) << bit;
+            }
+            bigShiftRightOne(shifted);
+        }
+        return quotient;
+    }
+
+    // Nearest double to the digits of [begin, end) (one optional decimal point) times 10^exponent, ties to even
+    static constexpr double decimalToDouble(const char* begin, const char* end, int64_t exponent)
+    {
+        char digits[maxSignificantDigits] = {};
+        int count = 0;
+        bool afterPoint = false;
+        for (const char* position = begin; position != end; position++)
+        {
+            if (*position == '.')
+            {
+                afterPoint = true;
+                continue;
+            }
+            if (afterPoint) exponent--;
+            if (count == 0 && *position == '0') continue; // Leading zeros
+            if (count == maxSignificantDigits) throw std::invalid_argument("Invalid number format: too many digits for ConstExpression");
+            digits[count++] = *position;
+        }
+        while (count > 0 && digits[count - 1] == '0')
+        {
+            count--;
+            exponent++;
+        }
+        if (count == 0) return 0;
+        if (count + exponent > 310) return ConstMath::infinity; // At least 10^309
+        if (count + exponent < -324) return 0;                  // Below 10^-324, under half the smallest subnormal
+
+        // Exact integer mantissa and power of ten: one correctly rounded operation
+        uint64_t mantissa = 0;
+        for (int digit = 0; digit < count && digit < 19; digit++) mantissa = mantissa * 10 + (digits[digit] - '0');
+        if (count <= 19 && mantissa < 9007199254740992ull && exponent >= -22 && exponent <= 22) // 2^53
+        {
+            double power = 1;
+            for (int64_t step = (exponent < 0) ? -exponent : exponent; step > 0; step--) power *= 10;
+            return (exponent < 0) ? static_cast<double>(mantissa) / power : static_cast<double>(mantissa) * power;
+        }
+
+        // value = numerator / denominator exactly; find shift with 2^52 <= numerator 2^shift / denominator < 2^53
+        BigNumber numerator{};
+        for (int digit = 0; digit < count; digit++) bigMultiplyAdd(numerator, 10, static_cast<uint32_t>(digits[digit] - '0'));
+        BigNumber denominator = bigPowerOfTen((exponent < 0) ? static_cast<int>(-exponent) : 0);
+        if (exponent > 0)
+        {
+            const BigNumber scale = bigPowerOfTen(static_cast<int>(exponent));
+            BigNumber product{};
+            for (int limb = scale.count - 1; limb >= 0; limb--)
+            {
+                product = bigShiftLeft(product, 32);
+                BigNumber term = numerator;
+                bigMultiplyAdd(term, scale.limbs[limb], 0);
+                // product += term
+                uint64_t carry = 0;
+                const int limbs = (term.count > product.count) ? term.count : product.count;
+                for (int index = 0; index < limbs; index++)
+                {
+                    const uint64_t sum = static_cast<uint64_t>(product.limbs[index]) + term.limbs[index] + carry;
+                    product.limbs[index] = static_cast<uint32_t>(sum);
+                    carry = sum >> 32;
+                }
+                product.count = limbs;
+                if (carry != 0) product.limbs[product.count++] = static_cast<uint32_t>(carry);
+            }
+            numerator = product;
+        }
+
+        int shift = 52 - (bigBitLength(numerator) - bigBitLength(denominator));
+        uint64_t quotient = 0;
+        BigNumber remainder{}, divisor{};
+        while (true)
+        {
+            if (shift > 1074) shift = 1074; // Subnormal: the grid stops at 2^-1074
+            remainder = (shift > 0) ? bigShiftLeft(numerator, shift) : numerator;
+            divisor = (shift < 0) ? bigShiftLeft(denominator, -shift) : denominator;
+            quotient = bigDivide(remainder, divisor);
+            if (quotient >= (uint64_t(1) << 53)) shift--;
+            else if (quotient < (uint64_t(1) << 52) && shift < 1074) shift++;
+            else break;
+        }
+
+        // Round on the remainder: above half the divisor up, exactly half to even
+        const int half = bigCompare(bigShiftLeft(remainder, 1), divisor);
+        if (half > 0 || (half == 0 && (quotient & 1)))
+        {
+            quotient++;
+            if (quotient == (uint64_t(1) << 53))
+            {
+                quotient >>= 1;
+                shift--;
+            }
+        }
+        if (52 - shift > 1023) return ConstMath::infinity;
+        return ConstMath::scaleByPowerOfTwo(static_cast<double>(quotient), -shift); // Exact
+    }
+
+    /*---- Functions ----*/
+    // Calculator::toReducedRadians
+    static constexpr double reduce(double angle, bool radianMode, int& quadrant)
+    {
+        quadrant = 0;
+        if (radianMode) return ConstMath::reduceAngle(angle, quadrant);
+        if (!ConstMath::isFinite(angle)) return ConstMath::notANumber;
+        return ConstMath::reduceDegrees(ConstMath::fmod(angle, 360.0), quadrant);
+    }
+
+    // evaluateRPN's tan: calcSinCos and its errorThreshold test
+    static constexpr double tan(double angle, bool radianMode, int terms, double errorThreshold)
+    {
+        int quadrant = 0;
+        const double theta = reduce(angle, radianMode, quadrant);
+        const double sinTheta = ConstMath::sinSeries(theta, terms);
+        const double cosTheta = ConstMath::cosSeries(theta, terms);
+        double sinValue = (quadrant & 1) ? cosTheta : sinTheta;
+        double cosValue = (quadrant & 1) ? sinTheta : cosTheta;
+        if (quadrant & 2) sinValue = -sinValue;
+        if ((quadrant + 1) & 2) cosValue = -cosValue;
+        if (ConstMath::abs(sinValue) < errorThreshold) sinValue = 0;
+        if (ConstMath::abs(cosValue) < errorThreshold || cosValue == 0) throw std::runtime_error("Tangent undefined at this angle");
+        return ConstMath::divide(sinValue, cosValue);
+    }
+
+    // Calculator::applyFunction: clampToDomain, the kernel, adjustResult
+    static constexpr double applyFunction(OpCode function, double value, bool radianMode, double errorThreshold)
+    {
+        const char* const domainError = "Argument outside the domain of the function";
+        switch (function)
+        {
+            case OP_LN:
+            case OP_LOG:
+                if (value <= 0) throw std::runtime_error(domainError);
+                break;
+            case OP_SQRT:
+                if (value >= 0 || ConstMath::isNaN(value)) break;
+                if (value <= -errorThreshold) throw std::runtime_error(domainError);
+                value = 0; // Rounding noise below zero
+                break;
+            case OP_ASIN:
+            case OP_ACOS:
+                if (!(ConstMath::abs(value) > 1)) break;
+                if (ConstMath::abs(value) > 1 + errorThreshold) throw std::runtime_error(domainError);
+                value = (value > 0) ? 1 : -1; // Rounding noise past +-1
+                break;
+            default: break;
+        }
+        switch (function)
+        {
+            case OP_EXP: value = ConstMath::exp(value); break;
+            case OP_LN: value = ConstMath::ln(value); break;
+            case OP_LOG: value = ConstMath::log10(value); break;
+            case OP_SQRT: value = ConstMath::sqrt(value); break;
+            case OP_ABS: value = ConstMath::abs(value); break;
+            case OP_ASIN: value = ConstMath::asin(value); break;
+            case OP_ACOS: value = ConstMath::acos(value); break;
+            case OP_ATAN: value = ConstMath::atan(value); break;
+            case OP_SINH: value = ConstMath::sinh(value); break;
+            case OP_COSH: value = ConstMath::cosh(value); break;
+            case OP_TANH: value = ConstMath::tanh(value); break;
+            default: break;
+        }
+        if ((function == OP_ASIN || function == OP_ACOS || function == OP_ATAN) && !radianMode) value *= 180 / ConstMath::pi;
+        if (function != OP_EXP && function != OP_COSH && function != OP_SQRT && function != OP_ABS && ConstMath::abs(value) < errorThreshold) value = 0;
+        return value;
+    }
+};
+
+#endif
@@ -0,0 +1,827 @@
+#ifndef CONST_MATH_H
+#define CONST_MATH_H
+
+#include <cstdint>
+#include <limits>
+
+// Coefficient table of a series, built at compile time so the kernels only run Horner's rule
+template <int Terms>
+struct SeriesCoefficients
+{
+    double values[Terms];
+};
+
+// Builders for ConstMath's tables
+class SeriesBuilder
+{
+public:
+    // (-1)^k / (2k+1)! for sin and (-1)^k / (2k)! for cos
+    template <int Terms>
+    static constexpr SeriesCoefficients<Terms> taylor(bool sine)
+    {
+        SeriesCoefficients<Terms> table{};
+        double factorial = 1; // (2k)! on entry to each iteration
+        double sign = 1;
+        for (int index = 0; index < Terms; index++)
+        {
+            if (!sine) table.values[index] = sign / factorial;
+            factorial *= 2 * index + 1;
+            if (sine) table.values[index] = sign / factorial;
+            factorial *= 2 * index + 2;
+            sign = -sign;
+        }
+        return table;
+    }
+
+    // 1/k! for k = 0 .. Terms-1
+    template <int Terms>
+    static constexpr SeriesCoefficients<Terms> exp()
+    {
+        SeriesCoefficients<Terms> table{};
+        double factorial = 1;
+        for (int index = 0; index < Terms; index++)
+        {
+            table.values[index] = 1 / factorial;
+            factorial *= index + 1;
+        }
+        return table;
+    }
+
+    // 2/(2k+1) for k = 1 .. Terms: ln((1+s)/(1-s)) = 2s + s * (these in s^2)
+    template <int Terms>
+    static constexpr SeriesCoefficients<Terms> ln()
+    {
+        SeriesCoefficients<Terms> table{};
+        for (int index = 0; index < Terms; index++) table.values[index] = 2.0 / (2 * index + 3);
+        return table;
+    }
+
+    // (-1)^k/(2k+1) for k = 1 .. Terms: atan(u) = u + u * (these in u^2)
+    template <int Terms>
+    static constexpr SeriesCoefficients<Terms> atan()
+    {
+        SeriesCoefficients<Terms> table{};
+        double sign = -1;
+        for (int index = 0; index < Terms; index++)
+        {
+            table.values[index] = sign / (2 * index + 3);
+            sign = -sign;
+        }
+        return table;
+    }
+
+    // 1/(2k+1)! for k = 1 .. Terms: sinh(x) = x + x * (these in x^2)
+    template <int Terms>
+    static constexpr SeriesCoefficients<Terms> sinh()
+    {
+        SeriesCoefficients<Terms> table{};
+        double factorial = 6; // 3!
+        for (int index = 0; index < Terms; index++)
+        {
+            table.values[index] = 1 / factorial;
+            factorial *= (2 * index + 4) * (2 * index + 5);
+        }
+        return table;
+    }
+};
+
+// constexpr math shared by run time and compile time. The series tables, argument reductions and combining steps
+// here are the ones Calculator's trig functions and MathKernels run, so ConstExpression evaluating a formula during
+// compilation gets the same bits as evaluateExpression. Where MathKernels reads or builds a double's bits, the
+// kernels here reach the same values with exact power-of-two scaling instead.
+//
+// Constant evaluation rejects any operation that overflows or makes a NaN out of numbers, so the kernels and the
+// arithmetic helpers settle those results before computing anything.
+class ConstMath
+{
+public:
+    static constexpr double infinity = std::numeric_limits<double>::infinity();
+    static constexpr double notANumber = std::numeric_limits<double>::quiet_NaN();
+    static constexpr double pi = 3.141592653589793;
+
+    /*---- Series tables ----*/
+    // The trig series only ever see |theta| <= pi/4, where terms past their table are far below double precision.
+    // The others are cut where the next term drops below 2^-57 of the result over their reduced range.
+    static constexpr int maxTaylorTerms = 24;
+    static constexpr SeriesCoefficients<maxTaylorTerms> sinCoefficients = SeriesBuilder::taylor<maxTaylorTerms>(true);
+    static constexpr SeriesCoefficients<maxTaylorTerms> cosCoefficients = SeriesBuilder::taylor<maxTaylorTerms>(false);
+    static constexpr SeriesCoefficients<14> expCoefficients = SeriesBuilder::exp<14>();   // |r| <= ln2/2
+    static constexpr SeriesCoefficients<11> lnCoefficients = SeriesBuilder::ln<11>();     // s^2 <= 0.0295
+    static constexpr SeriesCoefficients<7> atanCoefficients = SeriesBuilder::atan<7>();   // |u| <= 1/16
+    static constexpr SeriesCoefficients<8> sinhCoefficients = SeriesBuilder::sinh<8>();   // |x| < 1
+
+    /*---- Constants ----*/
+    static constexpr double pio2Hi = 1.5707963267948966;         // pi/2 split into two doubles
+    static constexpr double pio2Lo = 6.123233995736766e-17;
+    static constexpr double ln2Hi = 6.93147180369123816490e-01;  // ln 2 with the low 32 bits clear, so k * ln2Hi is exact
+    static constexpr double ln2Lo = 1.90821492927058770002e-10;
+    static constexpr double log2e = 1.4426950408889634;
+    static constexpr double roundingShifter = 6755399441055744.0; // 1.5 * 2^52: adding and subtracting it rounds to an integer
+    static constexpr double expOverflow = 709.782712893384;       // exp(x) is above the largest double past this
+    static constexpr double expUnderflow = -745.1332191019412;    // and rounds to 0 below this
+    static constexpr double invLn10 = 0.4342944819032518;
+    static constexpr double log10TwoHi = 3.01029995663611771306e-01; // log10(2) with the low bits clear, so e * log10TwoHi is exact
+    static constexpr double log10TwoLo = 3.69423907715893078616e-13;
+    static constexpr double smallestNormal = 2.2250738585072014e-308;
+
+    // pi/2 split into 33 bit pieces (Cody-Waite): n * piOver2Part1/2/3 is exact for n < 2^20, so the subtractions
+    // in reduceAngle do not lose the low bits of the argument
+    static constexpr double piOver2Part1 = 1.57079632673412561417e+00;
+    static constexpr double piOver2Part2 = 6.07710050630396597660e-11;
+    static constexpr double piOver2Part3 = 2.02226624871116645580e-21;
+    static constexpr double piOver2Part3Tail = 8.47842766036889956997e-32;
+    static constexpr double twoOverPi = 6.36619772367581382433e-01;
+    static constexpr double codyWaiteLimit = 1647099.0; // ~2^20 * pi/2
+
+    // Bits of 2/pi after the binary point, enough for the largest finite double (Payne-Hanek)
+    static constexpr uint32_t twoOverPiBits[] =
+    {
+        0xA2F9836E, 0x4E441529, 0xFC2757D1, 0xF534DDC0, 0xDB629599, 0x3C439041, 0xFE5163AB, 0xDEBBC561,
+        0xB7246E3A, 0x424DD2E0, 0x06492EEA, 0x09D1921C, 0xFE1DEB1C, 0xB129A73E, 0xE88235F5, 0x2EBB4484,
+        0xE99C7026, 0xB45F7E41, 0x3991D639, 0x835339F4, 0x9C845F8B, 0xBDF9283B, 0x1FF897FF, 0xDE05980F,
+        0xEF2F118B, 0x5A0A6D1F, 0x6D367ECF, 0x27CB09B7, 0x4F463F66, 0x9E5FEA2D, 0x7527BAC7, 0xEBE5F17B,
+        0x3D0739F7, 0x8A5292EA, 0x6BFB5FB1, 0x1F8D5D08, 0x56033046, 0xFC7B6BAB, 0xF0CFBC20, 0x9AF4361D
+    };
+
+    // atan(j/8) for j = 0 .. 8 split into two doubles
+    static constexpr double atanTable[9][2] =
+    {
+        {0.0, 0.0},
+        {0.12435499454676144, -3.1253241424539383e-18},
+        {0.24497866312686414, 1.0698755618734451e-17},
+        {0.35877067027057225, -2.4623815582638635e-17},
+        {0.4636476090008061, 2.2698777452961687e-17},
+        {0.5585993153435624, -5.4556305485916264e-18},
+        {0.6435011087932844, 1.5834785051444286e-17},
+        {0.7188299996216245, -2.1478388444456983e-17},
+        {0.7853981633974483, 3.061616997868383e-17}
+    };
+
+    /*---- Basics ----*/
+    static constexpr bool isNaN(double x) { return x != x; }
+    static constexpr bool isFinite(double x) { return x == x && x != infinity && x != -infinity; }
+    static constexpr double abs(double x) { return (x < 0) ? -x : (x > 0) ? x : (x == 0) ? 0.0 : notANumber; } // NaN comes out positive, as from std::fabs
+
+    // Nearest integer, ties to even, for |x| < 2^51
+    static constexpr double roundToInteger(double x) { return (x + roundingShifter) - roundingShifter; }
+
+    static constexpr bool isInteger(double x)
+    {
+        const double magnitude = abs(x);
+        return magnitude >= 4503599627370496.0 || (magnitude + 4503599627370496.0) - 4503599627370496.0 == magnitude; // 2^52
+    }
+
+    // 2^exponent for -1074 <= exponent <= 1023, exact
+    static constexpr double powerOfTwo(int exponent)
+    {
+        double result = 1;
+        if (exponent < -1022) // Subnormal: the last factor lands exactly on it
+        {
+            result = powerOfTwo(-1022);
+            exponent += 1022;
+        }
+        double factor = (exponent < 0) ? 0.5 : 2.0;
+        for (int remaining = (exponent < 0) ? -exponent : exponent; remaining != 0; remaining >>= 1)
+        {
+            if (remaining & 1) result *= factor;
+            if (remaining > 1) factor *= factor;
+        }
+        return result;
+    }
+
+    // floor(log2(x)) for positive finite x, subnormals included
+    static constexpr int binaryExponent(double x)
+    {
+        int exponent = 0;
+        if (x >= 1)
+        {
+            for (int step = 512; step >= 1; step /= 2)
+            {
+                if (x >= powerOfTwo(step))
+                {
+                    x *= powerOfTwo(-step);
+                    exponent += step;
+                }
+            }
+            return exponent;
+        }
+        while (x < powerOfTwo(-512))
+        {
+            x *= powerOfTwo(512);
+            exponent -= 512;
+        }
+        for (int step = 256; step >= 1; step /= 2)
+        {
+            if (x < powerOfTwo(-step))
+            {
+                x *= powerOfTwo(step);
+                exponent -= step;
+            }
+        }
+        return exponent - 1; // x is now in [1/2, 1)
+    }
+
+    // x * 2^exponent rounded once, as ldexp: every factor but the last keeps the value normal and is exact
+    static constexpr double scaleByPowerOfTwo(double x, int exponent)
+    {
+        if (x == 0 || !isFinite(x)) return x;
+        const int top = binaryExponent(abs(x)) + exponent;
+        if (top > 1023) return (x < 0) ? -infinity : infinity;
+        if (top < -1075) return (x < 0) ? -0.0 : 0.0;
+        int normalLimit = -1022 - binaryExponent(abs(x)); // Lowest exponent that keeps x normal
+        int exact = (exponent < normalLimit) ? normalLimit : exponent;
+        while (exact > 1023 || exact < -1022)
+        {
+            const int step = (exact > 0) ? 1023 : -1022;
+            x *= powerOfTwo(step);
+            exact -= step;
+            exponent -= step;
+        }
+        x *= powerOfTwo(exact);
+        return x * powerOfTwo(exponent - exact);
+    }
+
+    // x mod y for finite x and finite y > 0, exactly as fmod: each subtraction is exact (Sterbenz)
+    static constexpr double fmod(double x, double y)
+    {
+        double remainder = abs(x);
+        if (remainder < y) return x;
+        double multiple = y;
+        while (multiple <= remainder * 0.5) multiple *= 2;
+        for (; multiple >= y; multiple *= 0.5)
+        {
+            if (remainder >= multiple) remainder -= multiple;
+        }
+        return (x < 0) ? -remainder : remainder;
+    }
+
+    // 64 x 64 -> 128 bit product
+    static constexpr void multiply64(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low)
+    {
+        const uint64_t aLow = a & 0xFFFFFFFF, aHigh = a >> 32;
+        const uint64_t bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+        const uint64_t lowLow = aLow * bLow;
+        const uint64_t highLow = aHigh * bLow;
+        const uint64_t lowHigh = aLow * bHigh;
+        const uint64_t middle = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + (lowHigh & 0xFFFFFFFF);
+        low = (middle << 32) | (lowLow & 0xFFFFFFFF);
+        high = aHigh * bHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32);
+    }
+
+    // Correctly rounded, as std::sqrt: Newton's method gets within an ulp, then integer arithmetic picks the double
+    // nearest the root
+    static constexpr double sqrt(double x)
+    {
+        if (x == 0 || x == infinity || isNaN(x)) return x;
+        if (x < 0) return notANumber;
+        int exponent = binaryExponent(x);
+        exponent -= exponent & 1; // Even, so x = m * 2^exponent with m in [1, 4) and sqrt(x) = sqrt(m) * 2^(exponent/2)
+        const double m = scaleByPowerOfTwo(x, -exponent);
+        double root = 1.5;
+        for (int iteration = 0; iteration < 6; iteration++) root = 0.5 * (root + m / root);
+
+        // root = R * 2^-52 and m = M * 2^-52; R is right when (2R - 1)^2 <= 4 M 2^52 < (2R + 1)^2
+        const uint64_t scaledM = static_cast<uint64_t>(m * 4503599627370496.0);
+        const uint64_t targetHigh = scaledM >> 10, targetLow = scaledM << 54;
+        uint64_t rootBits = static_cast<uint64_t>(root * 4503599627370496.0);
+        auto squareBelow = [&](uint64_t odd) // odd^2 < 4 M 2^52
+        {
+            uint64_t high = 0, low = 0;
+            multiply64(odd, odd, high, low);
+            return high < targetHigh || (high == targetHigh && low < targetLow);
+        };
+        while (squareBelow(2 * rootBits + 1)) rootBits++;
+        while (!squareBelow(2 * rootBits - 1)) rootBits--;
+        return static_cast<double>(rootBits) * powerOfTwo(-52) * powerOfTwo(exponent / 2);
+    }
+
+    /*---- Arithmetic ----*/
+    // The operators as the hardware computes them, including the infinite and NaN results constant evaluation
+    // refuses to produce directly. divide takes a non-zero divisor.
+    static constexpr double add(double a, double b)
+    {
+        if (isNaN(a) || isNaN(b)) return notANumber;
+        if (!isFinite(a) || !isFinite(b))
+        {
+            if (!isFinite(a) && !isFinite(b) && (a > 0) != (b > 0)) return notANumber; // inf - inf
+            return isFinite(a) ? b : a;
+        }
+        // a + b rounds to infinity exactly when a/2 + b/2 rounds to 2^1023 or more
+        const double half = a * 0.5 + b * 0.5;
+        if (abs(half) >= powerOfTwo(1023)) return (half < 0) ? -infinity : infinity;
+        return a + b;
+    }
+
+    static constexpr double multiply(double a, double b)
+    {
+        if (isNaN(a) || isNaN(b)) return notANumber;
+        if (!isFinite(a) || !isFinite(b))
+        {
+            if (a == 0 || b == 0) return notANumber; // inf * 0
+            return ((a < 0) != (b < 0)) ? -infinity : infinity;
+        }
+        if (a == 0 || b == 0) return a * b;
+        const int exponents = binaryExponent(abs(a)) + binaryExponent(abs(b)); // The product is in [2^exponents, 2^(exponents + 2))
+        if (exponents >= 1024 || (exponents >= 1022 && abs((a * 0.25) * b) >= powerOfTwo(1022)))
+        {
+            return ((a < 0) != (b < 0)) ? -infinity : infinity;
+        }
+        return a * b;
+    }
+
+    static constexpr double divide(double a, double b)
+    {
+        if (isNaN(a) || isNaN(b)) return notANumber;
+        if (!isFinite(a)) return !isFinite(b) ? notANumber : ((a < 0) != (b < 0)) ? -infinity : infinity;
+        if (!isFinite(b) || a == 0) return a / b;
+        const int exponents = binaryExponent(abs(a)) - binaryExponent(abs(b)); // The quotient is in (2^(exponents - 1), 2^(exponents + 1))
+        if (exponents >= 1025 || (exponents >= 1022 && abs((a * 0.25) / b) >= powerOfTwo(1022)))
+        {
+            return ((a < 0) != (b < 0)) ? -infinity : infinity;
+        }
+        return a / b;
+    }
+
+    /*---- Series ----*/
+    // Horner's rule in z over a coefficient table
+    template <int Terms>
+    static constexpr double horner(const SeriesCoefficients<Terms>& coefficients, double z)
+    {
+        double result = coefficients.values[Terms - 1];
+        for (int index = Terms - 2; index >= 0; index--) result = result * z + coefficients.values[index];
+        return result;
+    }
+
+    // Horner evaluation of the first terms of each trig series in theta^2
+    static constexpr double sinSeries(double theta, int terms)
+    {
+        if (terms <= 0) return 0;
+        const double theta2 = theta * theta;
+        double result = sinCoefficients.values[terms - 1];
+        for (int index = terms - 2; index >= 0; index--) result = result * theta2 + sinCoefficients.values[index];
+        return result * theta;
+    }
+
+    static constexpr double cosSeries(double theta, int terms)
+    {
+        if (terms <= 0) return 0;
+        const double theta2 = theta * theta;
+        double result = cosCoefficients.values[terms - 1];
+        for (int index = terms - 2; index >= 0; index--) result = result * theta2 + cosCoefficients.values[index];
+        return result;
+    }
+
+    /*---- Trigonometric ----*/
+    // Bring angle to within [-pi/4, pi/4]: angle = quadrant * pi/2 + reduced (quadrant mod 4). Cody-Waite below
+    // codyWaiteLimit, Payne-Hanek above.
+    static constexpr double reduceAngle(double angle, int& quadrant)
+    {
+        quadrant = 0;
+        const double magnitude = abs(angle);
+        if (magnitude <= 0.785398163397448279) return angle;
+        if (!isFinite(angle)) return notANumber;
+        if (magnitude >= codyWaiteLimit)
+        {
+            const int exponent = binaryExponent(magnitude) + 1; // |angle| = mantissa * 2^exponent, mantissa in [1/2, 1)
+            return reduceLargeAngle(angle, static_cast<uint64_t>(scaleByPowerOfTwo(magnitude, 53 - exponent)), exponent, quadrant);
+        }
+
+        const double n = roundToInteger(angle * twoOverPi);
+        double reduced = angle - n * piOver2Part1;
+        reduced -= n * piOver2Part2;
+        reduced -= n * piOver2Part3;
+        reduced -= n * piOver2Part3Tail;
+        quadrant = static_cast<int>(static_cast<int64_t>(n) & 3);
+        return reduced;
+    }
+
+    // Degree mode: whole turns (turns = angle mod 360) and quadrants come off exactly in degrees before converting
+    static constexpr double reduceDegrees(double turns, int& quadrant)
+    {
+        const double n = roundToInteger(turns / 90.0);
+        quadrant = static_cast<int>(static_cast<int64_t>(n) & 3);
+        return (turns - n * 90.0) * 3.141592653589793 / 180.0;
+    }
+
+    // sin and cos of quadrant * pi/2 + theta, with results within errorThreshold of zero made zero
+    static constexpr double sinReduced(double theta, int quadrant, int terms, double errorThreshold)
+    {
+        // sin(q*pi/2 + theta) cycles through sin, cos, -sin, -cos
+        double result = (quadrant & 1) ? cosSeries(theta, terms) : sinSeries(theta, terms);
+        if (quadrant & 2) result = -result;
+        return (abs(result) < errorThreshold) ? 0 : result;
+    }
+
+    static constexpr double cosReduced(double theta, int quadrant, int terms, double errorThreshold)
+    {
+        // cos(q*pi/2 + theta) cycles through cos, -sin, -cos, sin
+        double result = (quadrant & 1) ? sinSeries(theta, terms) : cosSeries(theta, terms);
+        if ((quadrant + 1) & 2) result = -result;
+        return (abs(result) < errorThreshold) ? 0 : result;
+    }
+
+    /*---- Exponential and logarithms ----*/
+    // x = k ln2 + r with |r| <= ln2/2; branch free so MathKernels' block pass vectorizes
+    static constexpr double expReduce(double x, double& k)
+    {
+        k = (x * log2e + roundingShifter) - roundingShifter;
+        return (x - k * ln2Hi) - k * ln2Lo;
+    }
+
+    static constexpr double exp(double x)
+    {
+        if (!(x <= expOverflow)) return isNaN(x) ? x : infinity;
+        if (x < expUnderflow) return 0;
+        double k = 0;
+        const double r = expReduce(x, k);
+        return scaleByPowerOfTwo(horner(expCoefficients, r), static_cast<int>(k));
+    }
+
+    // x = 2^e * (1 + f) with 1 + f in [sqrt(1/2), sqrt(2)); returns f, which is exact, and sets e. Only called for
+    // positive finite x.
+    static constexpr double lnReduce(double x, double& e)
+    {
+        int scaleExponent = 0;
+        if (x < smallestNormal) // Subnormal: scale into the normal range first, as MathKernels does
+        {
+            x *= 18014398509481984.0; // 2^54
+            scaleExponent = -54;
+        }
+        int exponent = binaryExponent(x);
+        double mantissa = scaleByPowerOfTwo(x, -exponent); // In [1, 2)
+        if (mantissa > 1.4142135623730951)
+        {
+            mantissa *= 0.5;
+            exponent++;
+        }
+        e = exponent + scaleExponent;
+        return mantissa - 1;
+    }
+
+    // ln(1 + f) = f - s*f + s*R with s = f/(2+f) and R = s^2 * (series in s^2), arranged so the exact f comes last
+    static constexpr double lnMantissa(double f, double s, double series)
+    {
+        const double halfSquare = 0.5 * f * f;
+        return f - (halfSquare - s * (halfSquare + s * s * series));
+    }
+
+    // Results for the arguments lnReduce does not take; false when x is positive and finite
+    static constexpr bool lnSpecial(double x, double& result)
+    {
+        if (x > 0 && x < infinity) return false;
+        result = (x == 0) ? -infinity : (x == infinity) ? x : notANumber; // Negative and NaN give NaN
+        return true;
+    }
+
+    static constexpr double lnCombine(double e, double lnMantissaValue)
+    {
+        return e * ln2Hi + (lnMantissaValue + e * ln2Lo);
+    }
+
+    static constexpr double log10Combine(double e, double lnMantissaValue)
+    {
+        return e * log10TwoHi + (lnMantissaValue * invLn10 + e * log10TwoLo);
+    }
+
+    static constexpr double ln(double x)
+    {
+        double result = 0;
+        if (lnSpecial(x, result)) return result;
+        double e = 0;
+        const double f = lnReduce(x, e);
+        const double s = f / (2 + f);
+        return lnCombine(e, lnMantissa(f, s, horner(lnCoefficients, s * s)));
+    }
+
+    static constexpr double log10(double x)
+    {
+        double result = 0;
+        if (lnSpecial(x, result)) return result;
+        double e = 0;
+        const double f = lnReduce(x, e);
+        const double s = f / (2 + f);
+        return log10Combine(e, lnMantissa(f, s, horner(lnCoefficients, s * s)));
+    }
+
+    // x^y with std::pow's special cases (the sign of a zero base aside). Integer exponents up to 2^31 multiply out in
+    // double-double arithmetic, so exact powers come out exact; other exponents go through exp(y ln x) with ln x and
+    // the product in double-double, so the rounding of ln x is not scaled up by y. Both are within an ulp and
+    // usually the correctly rounded result std::pow gives.
+    static constexpr double pow(double x, double y)
+    {
+        if (y == 0 || x == 1) return 1;
+        if (isNaN(x) || isNaN(y)) return notANumber;
+        const double magnitude = abs(x);
+        if (!isFinite(y))
+        {
+            if (magnitude == 1) return 1;
+            return ((magnitude > 1) == (y > 0)) ? infinity : 0;
+        }
+        const bool integer = isInteger(y);
+        const bool odd = integer && abs(y) < 9007199254740992.0 && !isInteger(y * 0.5); // 2^53
+        if (x == 0 || !isFinite(x))
+        {
+            const bool large = (x != 0) == (y > 0); // 0^-n and inf^n
+            const double result = large ? infinity : 0;
+            return (x < 0 && odd) ? -result : result;
+        }
+        if (x < 0 && !integer) return notANumber;
+        const double sign = (x < 0 && odd) ? -1 : 1;
+        if (!integer || abs(y) > 2147483648.0) return sign * powerByLogarithm(magnitude, y);
+        return sign * integerPower(magnitude, y);
+    }
+
+    /*---- Inverse trigonometric ----*/
+    // |x| > 1 goes through atan(|x|) = pi/2 - atan(1/|x|); the remaining t in [0, 1] is taken to the nearest j/8,
+    // atan(t) = atan(j/8) + atan(u) with u = (t - j/8) / (1 + t j/8) and |u| <= 1/16
+    static constexpr double atanReduce(double x, int& index)
+    {
+        const double magnitude = abs(x);
+        const double t = (magnitude > 1) ? 1 / magnitude : magnitude;
+        index = (t <= 1) ? static_cast<int>(t * 8 + 0.5) : 0; // NaN takes entry 0
+        const double nearest = index * 0.125;
+        return (t - nearest) / (1 + t * nearest);
+    }
+
+    static constexpr double atanCombine(double x, int index, double u, double series)
+    {
+        const double reduced = u + u * (u * u * series);
+        double result = 0;
+        if (x > 1 || x < -1) result = (pio2Hi - atanTable[index][0]) + (pio2Lo - (atanTable[index][1] + reduced));
+        else result = atanTable[index][0] + (atanTable[index][1] + reduced);
+        return (x < 0) ? -result : result;
+    }
+
+    static constexpr double atan(double x)
+    {
+        int index = 0;
+        const double u = atanReduce(x, index);
+        return atanCombine(x, index, u, horner(atanCoefficients, u * u));
+    }
+
+    // asin and acos go through atan. Near |x| = 1 they use acos(x) = 2 atan(sqrt((1-x)/(1+x))), where 1 - |x| is exact,
+    // instead of sqrt(1 - x^2), which is not.
+    static constexpr double asinCombine(double x, double atanValue)
+    {
+        if (x >= -0.5 && x <= 0.5) return atanValue;
+        const double result = pio2Hi - (2 * atanValue - pio2Lo); // pi/2 - acos(|x|)
+        return (x < 0) ? -result : result;
+    }
+
+    static constexpr double asin(double x)
+    {
+        const double magnitude = abs(x);
+        if (!(magnitude <= 1)) return notANumber;
+        return asinCombine(x, atan((magnitude <= 0.5) ? x / sqrt((1 - x) * (1 + x)) : sqrt((1 - magnitude) / (1 + magnitude))));
+    }
+
+    static constexpr double acos(double x)
+    {
+        if (!(abs(x) <= 1)) return notANumber;
+        if (x == -1) return 2 * atan(infinity); // (1 - x) / 0
+        return 2 * atan(sqrt((1 - x) / (1 + x)));
+    }
+
+    /*---- Hyperbolic ----*/
+    // |x| < 1 uses the series for sinh, where e^x - e^-x would cancel; larger arguments go through exp(|x|), and past
+    // the point where exp overflows through exp(|x|/2)^2 / 2
+    static constexpr double sinhSmall(double x, double series)
+    {
+        return x + x * (x * x * series);
+    }
+
+    static constexpr double sinh(double x)
+    {
+        const double magnitude = abs(x);
+        if (magnitude < 1) return sinhSmall(x, horner(sinhCoefficients, x * x));
+        const double result = (magnitude <= expOverflow) ? 0.5 * (exp(magnitude) - 1 / exp(magnitude)) : multiply(0.5 * exp(0.5 * magnitude), exp(0.5 * magnitude));
+        return (x < 0) ? -result : result;
+    }
+
+    static constexpr double cosh(double x)
+    {
+        const double magnitude = abs(x);
+        if (magnitude <= expOverflow) return 0.5 * (exp(magnitude) + 1 / exp(magnitude));
+        return multiply(0.5 * exp(0.5 * magnitude), exp(0.5 * magnitude));
+    }
+
+    // tanh(x) = sinh/sqrt(1 + sinh^2) below 1, 1 - 2/(e^2|x| + 1) up to 22 and +-1 past that
+    static constexpr double tanh(double x)
+    {
+        const double magnitude = abs(x);
+        double result = 0;
+        if (magnitude < 1)
+        {
+            const double sinhValue = sinhSmall(magnitude, horner(sinhCoefficients, x * x));
+            result = sinhValue / sqrt(1 + sinhValue * sinhValue);
+        }
+        else if (magnitude > 22) result = 1;
+        else result = 1 - 2 / (exp(2 * magnitude) + 1); // NaN stays NaN
+        return (x < 0) ? -result : result;
+    }
+
+    // Payne-Hanek reduction for |x| >= codyWaiteLimit: multiplies the 53 bit mantissa by only the 192 bits of 2/pi that
+    // affect x * 2/pi mod 4, giving the quadrant and the fraction of a quadrant exactly enough for a double result.
+    // |x| = integerMantissa * 2^(exponent - 53) as from std::frexp, which is much cheaper at run time than the
+    // constexpr split reduceAngle does.
+    static constexpr double reduceLargeAngle(double x, uint64_t integerMantissa, int exponent, int& quadrant)
+    {
+        const int scale = exponent - 53;
+
+        // Bits of 2/pi worth 4 or more after scaling only add whole turns, so the window starts at weight 2^1
+        const int firstBit = (scale - 1 > 1) ? scale - 1 : 1;
+        const uint64_t window[3] = {twoOverPiWindow(firstBit), twoOverPiWindow(firstBit + 64), twoOverPiWindow(firstBit + 128)};
+
+        // product = integerMantissa * window as four 64 bit limbs, most significant first
+        uint64_t product[4] = {0, 0, 0, 0};
+        for (int limb = 2; limb >= 0; limb--)
+        {
+            uint64_t high = 0, low = 0;
+            multiply64(integerMantissa, window[limb], high, low);
+            // Add high:low into product[limb]:product[limb + 1]
+            uint64_t sum = product[limb + 1] + low;
+            const uint64_t carry = (sum < low) ? 1 : 0;
+            product[limb + 1] = sum;
+            sum = product[limb] + high + carry;
+            product[limb] = sum;
+        }
+
+        // The binary point of x * 2/pi sits pointPosition bits above the bottom of the product
+        const int pointPosition = 191 + firstBit - scale;
+        auto bitsFrom = [&](int start) -> uint64_t // 64 bits of the product starting at bit 'start', which may be negative
+        {
+            if (start <= -64) return 0;
+            if (start < 0) return product[3] << -start;
+            const int limb = start / 64;
+            const int offset = start % 64;
+            uint64_t result = product[3 - limb] >> offset;
+            if (offset != 0 && limb < 3) result |= product[2 - limb] << (64 - offset);
+            return result;
+        };
+        const int integerBits = static_cast<int>(bitsFrom(pointPosition) & 3);
+        uint64_t fractionHigh = bitsFrom(pointPosition - 64);
+        uint64_t fractionLow = bitsFrom(pointPosition - 128);
+
+        // Round to the nearest quadrant so the remainder lies in [-1/2, 1/2) of a quadrant
+        quadrant = integerBits;
+        double sign = 1;
+        if (fractionHigh >> 63)
+        {
+            quadrant = (quadrant + 1) & 3;
+            fractionLow = ~fractionLow + 1;
+            fractionHigh = ~fractionHigh + (fractionLow == 0 ? 1 : 0);
+            sign = -1;
+        }
+        constexpr double twoToMinus64 = powerOfTwo(-64), twoToMinus128 = powerOfTwo(-128);
+        const double fraction = static_cast<double>(fractionHigh) * twoToMinus64 + static_cast<double>(fractionLow) * twoToMinus128;
+        double reduced = sign * fraction * (piOver2Part1 + piOver2Part2);
+
+        if (x < 0)
+        {
+            reduced = -reduced;
+            quadrant = (4 - quadrant) & 3;
+        }
+        return reduced;
+    }
+
+private:
+    // 64 bits of 2/pi starting at bit firstBit (bit 1 is the first bit after the binary point)
+    static constexpr uint64_t twoOverPiWindow(int firstBit)
+    {
+        const int word = (firstBit - 1) / 32;
+        const int offset = (firstBit - 1) % 32;
+        const uint64_t high = (static_cast<uint64_t>(twoOverPiBits[word]) << 32) | twoOverPiBits[word + 1];
+        if (offset == 0) return high;
+        return (high << offset) | (twoOverPiBits[word + 2] >> (32 - offset));
+    }
+
+    // a * b = high + low exactly (Dekker), for products and splits well inside the double range
+    static constexpr void twoProduct(double a, double b, double& high, double& low)
+    {
+        high = a * b;
+        const double aSplit = a * 134217729.0, bSplit = b * 134217729.0; // 2^27 + 1
+        const double aHigh = aSplit - (aSplit - a), aLow = a - aHigh;
+        const double bHigh = bSplit - (bSplit - b), bLow = b - bHigh;
+        low = ((aHigh * bHigh - high) + aHigh * bLow + aLow * bHigh) + aLow * bLow;
+    }
+
+    // (aHigh + aLow) * (bHigh + bLow) in double-double, for mantissas in [1, 2)
+    static constexpr void multiplyDouble(double& aHigh, double& aLow, double bHigh, double bLow)
+    {
+        double high = 0, low = 0;
+        twoProduct(aHigh, bHigh, high, low);
+        low += aHigh * bLow + aLow * bHigh;
+        aHigh = high + low;
+        aLow = low - (aHigh - high);
+    }
+
+    // Brings a double-double into [1, 2), moving the factors of two to exponent
+    static constexpr void normalize(double& high, double& low, int64_t& exponent)
+    {
+        if (high >= 2)
+        {
+            high *= 0.5;
+            low *= 0.5;
+            exponent++;
+        }
+    }
+
+    // ln x as high + low for positive finite x. f from lnReduce is exact and the rounding of s = f / (2 + f) comes back
+    // as sLow, so only the small tail of ln(1 + f) = 2s + s * s^2 * (series in s^2) is in plain double precision.
+    static constexpr void lnDouble(double x, double& high, double& low)
+    {
+        double e = 0;
+        const double f = lnReduce(x, e);
+        const double divisorHigh = 2 + f, divisorLow = f - (divisorHigh - 2);
+        const double s = f / divisorHigh;
+        double product = 0, productLow = 0;
+        twoProduct(s, divisorHigh, product, productLow);
+        const double sLow = (((f - product) - productLow) - s * divisorLow) / divisorHigh;
+        const double tail = s * (s * s * horner(lnCoefficients, s * s));
+
+        // e ln2Hi and 2s are exact, and so is their sum split into high + low
+        const double a = e * ln2Hi, b = 2 * s;
+        high = a + b;
+        const double bPart = high - a;
+        low = (a - (high - bPart)) + (b - bPart);
+        low += 2 * sLow + tail + e * ln2Lo;
+        const double sum = high + low;
+        low -= sum - high;
+        high = sum;
+    }
+
+    // exp(y ln x) for finite x > 0 and finite y. The reduced argument is rHigh + rLow; e^r = 1 + rHigh + (rest) sums
+    // 1 + rHigh exactly as high + low, so only the small rest is rounded before the final addition.
+    static constexpr double powerByLogarithm(double x, double y)
+    {
+        double lnHigh = 0, lnLow = 0;
+        lnDouble(x, lnHigh, lnLow);
+        const double estimate = multiply(y, lnHigh);
+        if (!(abs(estimate) <= 2 * expOverflow)) return exp(estimate); // Overflows or underflows; also keeps the splits below finite
+        double productHigh = 0, productLow = 0;
+        twoProduct(y, lnHigh, productHigh, productLow);
+        productLow += y * lnLow;
+        const double argument = productHigh + productLow;
+        if (argument > expOverflow) return infinity;
+        if (argument < expUnderflow) return 0;
+        const double k = roundToInteger(productHigh * log2e);
+        // r = (productHigh - k ln2Hi) + (productLow - k ln2Lo); the first difference is exact, the sum is split exactly
+        const double reducedHigh = productHigh - k * ln2Hi, reducedLow = productLow - k * ln2Lo;
+        const double rHigh = reducedHigh + reducedLow;
+        const double lowPart = rHigh - reducedHigh;
+        const double rLow = (reducedHigh - (rHigh - lowPart)) + (reducedLow - lowPart);
+        double series = expCoefficients.values[13]; // e^rHigh = 1 + rHigh + rHigh^2 * series
+        for (int index = 12; index >= 2; index--) series = series * rHigh + expCoefficients.values[index];
+        const double head = 1 + rHigh, headLow = (1 - head) + rHigh;
+        const double result = head + (headLow + (rHigh * rHigh * series + rLow * (1 + rHigh)));
+        return scaleByPowerOfTwo(result, static_cast<int>(k));
+    }
+
+    // base^n for finite base > 0 and integer n, by binary exponentiation with base and result kept as mantissas in
+    // [1, 2) plus an exponent, so nothing overflows along the way
+    static constexpr double integerPower(double base, double n)
+    {
+        double count = abs(n);
+        int64_t baseExponent = binaryExponent(base);
+        double baseHigh = scaleByPowerOfTwo(base, -static_cast<int>(baseExponent)), baseLow = 0;
+        int64_t resultExponent = 0;
+        double resultHigh = 1, resultLow = 0;
+        const int64_t limit = 1 << 20; // Far past overflow and underflow for any exponent still to come
+        while (count >= 1)
+        {
+            const double half = roundToInteger(count * 0.5 - 0.25); // floor(count / 2)
+            if (count != 2 * half)
+            {
+                multiplyDouble(resultHigh, resultLow, baseHigh, baseLow);
+                resultExponent += baseExponent;
+                normalize(resultHigh, resultLow, resultExponent);
+            }
+            count = half;
+            if (count < 1) break;
+            multiplyDouble(baseHigh, baseLow, baseHigh, baseLow);
+            baseExponent *= 2;
+            normalize(baseHigh, baseLow, baseExponent);
+            if (baseExponent > limit || baseExponent < -limit) // Any remaining bit overflows or underflows
+            {
+                resultExponent += baseExponent;
+                break;
+            }
+        }
+        if (n < 0)
+        {
+            // 1 / (high + low): q = 1/high, then one correction step
+            const double quotient = 1 / resultHigh;
+            double productHigh = 0, productLow = 0;
+            twoProduct(quotient, resultHigh, productHigh, productLow);
+            const double remainder = ((1 - productHigh) - productLow) - quotient * resultLow;
+            resultHigh = quotient + quotient * remainder;
+            resultLow = 0;
+            resultExponent = -resultExponent;
+        }
+        if (resultExponent > 2000) return infinity;
+        if (resultExponent < -2000) return 0;
+        return scaleByPowerOfTwo(resultHigh + resultLow, static_cast<int>(resultExponent));
+    }
+};
+
+#endif
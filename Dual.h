@@ -0,0 +1,235 @@
+#ifndef DUAL_H
+#define DUAL_H
+
+#include <cmath>
+
+// Forward-mode automatic differentiation. A Dual carries a value together with its first derivatives with respect to
+// Inputs chosen inputs and, with Order 2, its second derivatives as well. Every operation applies the chain rule as it
+// goes, so one evaluation on Duals gives the value and all the requested derivatives, exact up to rounding, where
+// finite differences take one or two bumped re-evaluations per input and lose half the digits.
+//
+//     using RateDual = Dual<1, 2>; // d/di and d2/di2
+//     RateDual pv = calculator.calculatePV(RateDual(fv), RateDual(pmt), RateDual::variable(i, 0), RateDual(n));
+//     // pv.value, pv.gradient[0] (DV01 = -0.0001 * gradient[0]), pv.hessian[0][0] (convexity)
+//
+// Comparisons look at the value alone, so code written for double runs unchanged on Duals.
+template <int Inputs, int Order = 1>
+class Dual
+{
+public:
+    static_assert(Inputs >= 1 && (Order == 1 || Order == 2), "Dual carries first, or first and second, derivatives of one or more inputs");
+    static constexpr int hessianSize = (Order == 2) ? Inputs : 1;
+
+    double value;
+    double gradient[Inputs];                  // d value / d input
+    double hessian[hessianSize][hessianSize]; // d2 value / d row d column, Order 2 only
+
+    // A constant: every derivative is 0
+    Dual(double value = 0) : value(value), gradient(), hessian() {}
+
+    // Input number input at value: its derivative with respect to itself is 1
+    static Dual variable(double value, int input)
+    {
+        Dual result(value);
+        result.gradient[input] = 1;
+        return result;
+    }
+
+    // True when no input moves the value
+    bool isConstant() const
+    {
+        for (int row = 0; row < Inputs; row++)
+        {
+            if (gradient[row] != 0) return false;
+        }
+        if constexpr (Order == 2)
+        {
+            for (int row = 0; row < Inputs; row++)
+            {
+                for (int column = 0; column < Inputs; column++)
+                {
+                    if (hessian[row][column] != 0) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /*---- Chain rule ----*/
+    // f(this) for a linear f: the derivatives scale, the second derivative of f is 0
+    Dual linear(double f, double scale) const
+    {
+        Dual result(f);
+        for (int row = 0; row < Inputs; row++) result.gradient[row] = scale * gradient[row];
+        if constexpr (Order == 2)
+        {
+            for (int row = 0; row < Inputs; row++)
+            {
+                for (int column = 0; column < Inputs; column++) result.hessian[row][column] = scale * hessian[row][column];
+            }
+        }
+        return result;
+    }
+
+    // f(this) from f and its first and second derivatives at value
+    Dual chain(double f, double first, double second) const
+    {
+        Dual result(f);
+        for (int row = 0; row < Inputs; row++) result.gradient[row] = first * gradient[row];
+        if constexpr (Order == 2)
+        {
+            for (int row = 0; row < Inputs; row++)
+            {
+                for (int column = 0; column < Inputs; column++)
+                {
+                    result.hessian[row][column] = first * hessian[row][column] + second * gradient[row] * gradient[column];
+                }
+            }
+        }
+        return result;
+    }
+
+    // f(x, y) from f and its partial derivatives at (x.value, y.value)
+    static Dual chain(const Dual& x, const Dual& y, double f, double fx, double fy, double fxx, double fxy, double fyy)
+    {
+        Dual result(f);
+        for (int row = 0; row < Inputs; row++) result.gradient[row] = fx * x.gradient[row] + fy * y.gradient[row];
+        if constexpr (Order == 2)
+        {
+            for (int row = 0; row < Inputs; row++)
+            {
+                for (int column = 0; column < Inputs; column++)
+                {
+                    result.hessian[row][column] = fx * x.hessian[row][column] + fy * y.hessian[row][column] +
+                                                  fxx * x.gradient[row] * x.gradient[column] + fyy * y.gradient[row] * y.gradient[column] +
+                                                  fxy * (x.gradient[row] * y.gradient[column] + y.gradient[row] * x.gradient[column]);
+                }
+            }
+        }
+        return result;
+    }
+
+    /*---- Arithmetic ----*/
+    // Defined in the class so that doubles convert on either side: 1 + i, pv * growth
+    friend Dual operator+(const Dual& a, const Dual& b)
+    {
+        Dual result(a.value + b.value);
+        for (int row = 0; row < Inputs; row++) result.gradient[row] = a.gradient[row] + b.gradient[row];
+        if constexpr (Order == 2)
+        {
+            for (int row = 0; row < Inputs; row++)
+            {
+                for (int column = 0; column < Inputs; column++) result.hessian[row][column] = a.hessian[row][column] + b.hessian[row][column];
+            }
+        }
+        return result;
+    }
+
+    friend Dual operator-(const Dual& a, const Dual& b)
+    {
+        Dual result(a.value - b.value);
+        for (int row = 0; row < Inputs; row++) result.gradient[row] = a.gradient[row] - b.gradient[row];
+        if constexpr (Order == 2)
+        {
+            for (int row = 0; row < Inputs; row++)
+            {
+                for (int column = 0; column < Inputs; column++) result.hessian[row][column] = a.hessian[row][column] - b.hessian[row][column];
+            }
+        }
+        return result;
+    }
+
+    friend Dual operator-(const Dual& a) { return a.linear(-a.value, -1); }
+
+    friend Dual operator*(const Dual& a, const Dual& b)
+    {
+        Dual result(a.value * b.value);
+        for (int row = 0; row < Inputs; row++) result.gradient[row] = a.value * b.gradient[row] + b.value * a.gradient[row];
+        if constexpr (Order == 2)
+        {
+            for (int row = 0; row < Inputs; row++)
+            {
+                for (int column = 0; column < Inputs; column++)
+                {
+                    result.hessian[row][column] = a.value * b.hessian[row][column] + b.value * a.hessian[row][column] +
+                                                  a.gradient[row] * b.gradient[column] + b.gradient[row] * a.gradient[column];
+                }
+            }
+        }
+        return result;
+    }
+
+    // a/b = q with q' = (a' - q b') / b and q'' = (a'' - q b'' - q' b' - b' q') / b, on the rounded q
+    friend Dual operator/(const Dual& a, const Dual& b)
+    {
+        Dual result(a.value / b.value);
+        const double reciprocal = 1 / b.value;
+        for (int row = 0; row < Inputs; row++) result.gradient[row] = (a.gradient[row] - result.value * b.gradient[row]) * reciprocal;
+        if constexpr (Order == 2)
+        {
+            for (int row = 0; row < Inputs; row++)
+            {
+                for (int column = 0; column < Inputs; column++)
+                {
+                    result.hessian[row][column] = (a.hessian[row][column] - result.value * b.hessian[row][column] -
+                                                   result.gradient[row] * b.gradient[column] - b.gradient[row] * result.gradient[column]) * reciprocal;
+                }
+            }
+        }
+        return result;
+    }
+
+    // With a double: the same values, without the arithmetic on a constant's zero derivatives
+    friend Dual operator+(const Dual& a, double b) { return a.linear(a.value + b, 1); }
+    friend Dual operator+(double a, const Dual& b) { return b.linear(a + b.value, 1); }
+    friend Dual operator-(const Dual& a, double b) { return a.linear(a.value - b, 1); }
+    friend Dual operator-(double a, const Dual& b) { return b.linear(a - b.value, -1); }
+    friend Dual operator*(const Dual& a, double b) { return a.linear(a.value * b, b); }
+    friend Dual operator*(double a, const Dual& b) { return b.linear(a * b.value, a); }
+    friend Dual operator/(const Dual& a, double b) { return a.linear(a.value / b, 1 / b); }
+
+    friend Dual operator/(double a, const Dual& b)
+    {
+        const double quotient = a / b.value;
+        const double reciprocal = 1 / b.value;
+        return b.chain(quotient, -quotient * reciprocal, 2 * quotient * reciprocal * reciprocal);
+    }
+
+    friend bool operator==(const Dual& a, const Dual& b) { return a.value == b.value; }
+    friend bool operator!=(const Dual& a, const Dual& b) { return a.value != b.value; }
+    friend bool operator<(const Dual& a, const Dual& b) { return a.value < b.value; }
+    friend bool operator<=(const Dual& a, const Dual& b) { return a.value <= b.value; }
+    friend bool operator>(const Dual& a, const Dual& b) { return a.value > b.value; }
+    friend bool operator>=(const Dual& a, const Dual& b) { return a.value >= b.value; }
+
+    /*---- Functions ----*/
+    // Found by argument dependent lookup, next to the std:: ones a using-declaration brings in for double
+    friend Dual pow(const Dual& x, const Dual& y)
+    {
+        const double f = std::pow(x.value, y.value);
+        // x^(y-1) and x^(y-2) from f, except at x = 0 where they may be finite while f / x is not. The reciprocal
+        // is independent of f, so its division overlaps the pow call.
+        const double reciprocal = 1 / x.value;
+        const double fx = (x.value != 0) ? y.value * f * reciprocal : y.value * std::pow(x.value, y.value - 1);
+        const double fxx = (x.value != 0) ? (y.value - 1) * fx * reciprocal : (y.value - 1) * y.value * std::pow(x.value, y.value - 2);
+        if (y.isConstant()) return x.chain(f, fx, fxx);
+        // Variable exponent: x^y = e^(y ln x), defined for x > 0
+        const double logX = std::log(x.value);
+        const double fy = f * logX;
+        return chain(x, y, f, fx, fy, fxx, fx * logX + f * reciprocal, fy * logX);
+    }
+
+    friend Dual log1p(const Dual& x)
+    {
+        const double reciprocal = 1 / (1 + x.value);
+        return x.chain(std::log1p(x.value), reciprocal, -reciprocal * reciprocal);
+    }
+
+    friend Dual expm1(const Dual& x)
+    {
+        const double f = std::expm1(x.value);
+        return x.chain(f, f + 1, f + 1);
+    }
+};
+
+#endif
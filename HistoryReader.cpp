@@ -0,0 +1,246 @@
+#include "HistoryReader.h"
+#include "Calculator.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HISTORY_READER_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+HistoryReader::HistoryReader(const std::string& filename) : data(nullptr), size(0), mapped(false)
+{
+#ifdef HISTORY_READER_MMAP
+    const int descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0) throw std::runtime_error("Failed to open history file.");
+    struct stat status;
+    if (::fstat(descriptor, &status) != 0)
+    {
+        ::close(descriptor);
+        throw std::runtime_error("Failed to open history file.");
+    }
+    size = static_cast<size_t>(status.st_size);
+    if (size > 0)
+    {
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            ::close(descriptor);
+            throw std::runtime_error("Failed to map history file.");
+        }
+        ::madvise(mapping, size, MADV_SEQUENTIAL); // Replays read front to back
+        data = static_cast<const unsigned char*>(mapping);
+        mapped = true;
+    }
+    ::close(descriptor); // The mapping keeps the file contents reachable
+#else
+    std::ifstream inFile(filename, std::ios::binary);
+    if (!inFile.is_open()) throw std::runtime_error("Failed to open history file.");
+    buffer.assign(std::istreambuf_iterator<char>(inFile), std::istreambuf_iterator<char>());
+    data = buffer.data();
+    size = buffer.size();
+#endif
+
+    if (size < historyFileHeaderSize || std::memcmp(data, historyFileHeader, historyFileHeaderSize) != 0)
+    {
+#ifdef HISTORY_READER_MMAP
+        if (mapped) ::munmap(const_cast<unsigned char*>(data), size);
+#endif
+        throw std::runtime_error("Not a binary history file.");
+    }
+}
+
+HistoryReader::~HistoryReader()
+{
+#ifdef HISTORY_READER_MMAP
+    if (mapped) ::munmap(const_cast<unsigned char*>(data), size);
+#endif
+}
+
+// Reads a fixed width field from an unaligned position
+template <class Field>
+static Field readField(const unsigned char* position)
+{
+    Field field;
+    std::memcpy(&field, position, sizeof(field));
+    return field;
+}
+
+/*------------
+Record Walking
+-------------*/
+size_t HistoryReader::scan(const std::string* matchText, const std::function<void(const HistoryEntry&, uint32_t)>& visit) const
+{
+    const size_t resultFixedSize = 4 + 1 + 4 + 8 + 8 + 4;
+    const size_t variableSize = 4 + 8;
+
+    std::vector<std::string_view> strings; // Current meaning of each id
+    std::vector<char> matches;             // Whether each id currently names matchText
+    HistoryEntry entry;                    // Reused so decoding does not allocate per record
+    size_t visited = 0;
+
+    size_t offset = historyFileHeaderSize;
+    while (offset + 5 <= size)
+    {
+        const uint32_t length = readField<uint32_t>(data + offset);
+        if (length == 0 || length > size - offset - 4) break; // Truncated record
+        const uint8_t type = data[offset + 4];
+        const unsigned char* payload = data + offset + 5;
+        const size_t payloadSize = length - 1;
+        offset += 4 + length;
+
+        if (type == HISTORY_RECORD_STRING)
+        {
+            if (payloadSize < 4) break;
+            const uint32_t id = readField<uint32_t>(payload);
+            if (id >= strings.size())
+            {
+                strings.resize(id + 1);
+                matches.resize(id + 1, 0);
+            }
+            strings[id] = std::string_view(reinterpret_cast<const char*>(payload + 4), payloadSize - 4);
+            matches[id] = (matchText != nullptr && strings[id] == *matchText);
+        }
+        else if (type == HISTORY_RECORD_RESULT)
+        {
+            if (payloadSize < resultFixedSize) break;
+            const uint32_t expressionId = readField<uint32_t>(payload);
+            if (expressionId >= strings.size()) break;
+            if (matchText != nullptr && !matches[expressionId]) continue;
+
+            const uint32_t variableCount = readField<uint32_t>(payload + 25);
+            if (payloadSize < resultFixedSize + variableCount * variableSize) break;
+
+            entry.expression = strings[expressionId];
+            entry.radianMode = payload[4] != 0;
+            entry.taylorTerms = readField<int32_t>(payload + 5);
+            entry.errorThreshold = readField<double>(payload + 9);
+            entry.result = readField<double>(payload + 17);
+            entry.variableNames.clear();
+            entry.variableValues.clear();
+            const unsigned char* variable = payload + resultFixedSize;
+            bool valid = true;
+            for (uint32_t index = 0; index < variableCount; index++, variable += variableSize)
+            {
+                const uint32_t nameId = readField<uint32_t>(variable);
+                if (nameId >= strings.size())
+                {
+                    valid = false;
+                    break;
+                }
+                entry.variableNames.push_back(strings[nameId]);
+                entry.variableValues.push_back(readField<double>(variable + 4));
+            }
+            if (!valid) break;
+
+            visit(entry, expressionId);
+            visited++;
+        }
+        // Unknown record types are skipped so newer writers stay readable
+    }
+    return visited;
+}
+
+void HistoryReader::forEach(const std::function<void(const HistoryEntry&)>& visit) const
+{
+    scan(nullptr, [&](const HistoryEntry& entry, uint32_t) { visit(entry); });
+}
+
+size_t HistoryReader::forEachMatching(const std::string& expression, const std::function<void(const HistoryEntry&)>& visit) const
+{
+    return scan(&expression, [&](const HistoryEntry& entry, uint32_t) { visit(entry); });
+}
+
+/*------------
+Replay
+-------------*/
+HistoryReplayReport HistoryReader::replay(const Calculator& calculator, double tolerance,
+                                          const std::function<void(const HistoryEntry&, double)>& onMismatch) const
+{
+    // Each distinct expression is compiled once. A string's position in the mapped file identifies it uniquely,
+    // even when a later writer session reuses its id.
+    struct CachedProgram
+    {
+        Calculator::CompiledExpression compiled;
+        std::vector<const char*> names;
+        bool valid = false;
+    };
+    std::unordered_map<const char*, CachedProgram> programs;
+
+    // One calculator per distinct recorded settings combination; settings snapshots are kept for a calculator's
+    // lifetime, so switching one calculator back and forth per entry would accumulate them
+    std::map<std::tuple<bool, int, double>, Calculator> replayers;
+
+    HistoryReplayReport report = {0, 0, 0};
+    scan(nullptr, [&](const HistoryEntry& entry, uint32_t)
+    {
+        report.entries++;
+        auto replayerFound = replayers.try_emplace(std::make_tuple(entry.radianMode, entry.taylorTerms, entry.errorThreshold), calculator);
+        Calculator& replayer = replayerFound.first->second;
+        if (replayerFound.second)
+        {
+            replayer.updateSettings([&](Calculator::Settings& settings)
+            {
+                settings.saveHistory = false;
+                settings.radianMode = entry.radianMode;
+                settings.taylorTerms = entry.taylorTerms;
+                settings.errorThreshold = entry.errorThreshold;
+            });
+        }
+
+        auto found = programs.try_emplace(entry.expression.data());
+        CachedProgram& program = found.first->second;
+        std::vector<const char*> names;
+        names.reserve(entry.variableNames.size());
+        for (const std::string_view& name : entry.variableNames) names.push_back(name.data());
+        if (found.second || program.names != names)
+        {
+            std::vector<std::string> variableNames(entry.variableNames.begin(), entry.variableNames.end());
+            try
+            {
+                program.compiled = replayer.compile(std::string(entry.expression), variableNames);
+                program.valid = true;
+            }
+            catch (const std::exception&)
+            {
+                program.valid = false;
+            }
+            program.names = names;
+        }
+
+        double result = std::nan("");
+        bool failed = !program.valid;
+        if (!failed)
+        {
+            try
+            {
+                result = replayer.evaluate(program.compiled, entry.variableValues.data());
+            }
+            catch (const std::exception&)
+            {
+                failed = true;
+            }
+        }
+
+        if (failed)
+        {
+            report.errors++;
+            if (onMismatch) onMismatch(entry, result);
+        }
+        else if (!(std::fabs(result - entry.result) <= tolerance) && !(result == entry.result))
+        {
+            report.mismatches++;
+            if (onMismatch) onMismatch(entry, result);
+        }
+    });
+    return report;
+}
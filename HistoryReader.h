@@ -0,0 +1,80 @@
+#ifndef HISTORY_READER_H
+#define HISTORY_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Calculator;
+
+/*
+Binary history layout (HISTORY_BINARY), all fields in native byte order:
+    header:  "CALCHIST" then uint32 version
+    record:  uint32 length (bytes after this field), uint8 type, payload
+    STRING:  uint32 id, bytes of the string (expressions and variable names are written once and referenced by id)
+    RESULT:  uint32 expression id, uint8 radian mode, int32 Taylor terms, double error threshold, double result,
+             uint32 variable count, then per variable: uint32 name id, double value
+Ids restart at 0 each time a writer opens the file; a STRING record always precedes the records that use it.
+*/
+static const char historyFileHeader[] = {'C', 'A', 'L', 'C', 'H', 'I', 'S', 'T', 1, 0, 0, 0};
+static const size_t historyFileHeaderSize = sizeof(historyFileHeader);
+
+enum HistoryRecordType : uint8_t
+{
+    HISTORY_RECORD_STRING = 1,
+    HISTORY_RECORD_RESULT = 2
+};
+
+// One decoded RESULT record. The string views point into the mapped file and stay valid while the reader lives.
+struct HistoryEntry
+{
+    std::string_view expression;
+    std::vector<std::string_view> variableNames;
+    std::vector<double> variableValues;
+    double result;
+    bool radianMode;
+    int taylorTerms;
+    double errorThreshold;
+};
+
+// Outcome of re-evaluating a history file
+struct HistoryReplayReport
+{
+    size_t entries;    // Entries replayed
+    size_t mismatches; // Entries whose result differs from the recorded one by more than the tolerance
+    size_t errors;     // Entries that now fail to evaluate
+};
+
+// Memory-maps a binary history file and decodes it in place
+class HistoryReader
+{
+public:
+    explicit HistoryReader(const std::string& filename); // Throws std::runtime_error if it cannot open or map the file
+    ~HistoryReader();
+
+    HistoryReader(const HistoryReader&) = delete;
+    HistoryReader& operator=(const HistoryReader&) = delete;
+
+    // Visits every entry in file order; a truncated final record (e.g. from a crash) ends the iteration
+    void forEach(const std::function<void(const HistoryEntry&)>& visit) const;
+    // Visits only the entries for one expression, compared by interned id rather than per entry string compares
+    size_t forEachMatching(const std::string& expression, const std::function<void(const HistoryEntry&)>& visit) const;
+    // Re-evaluates every entry under its recorded settings with the given calculator's configuration otherwise;
+    // onMismatch (optional) sees each entry that no longer reproduces together with the new result (NaN on error)
+    HistoryReplayReport replay(const Calculator& calculator, double tolerance = 0,
+                               const std::function<void(const HistoryEntry&, double)>& onMismatch = nullptr) const;
+
+private:
+    // Walks the records; when matchText is set only RESULT records for that expression are decoded
+    size_t scan(const std::string* matchText, const std::function<void(const HistoryEntry&, uint32_t expressionId)>& visit) const;
+
+    const unsigned char* data;
+    size_t size;
+    std::vector<unsigned char> buffer; // Used instead of a mapping where mmap is unavailable
+    bool mapped;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "HistoryWriter.h"
+#include "HistoryReader.h"
+
+#include <stdexcept>
+
+HistoryWriter::HistoryWriter(const std::string& filename, HistoryFormat format, size_t batchSize, std::chrono::milliseconds flushInterval)
+    : filename(filename), format(format), batchSize(batchSize > 0 ? batchSize : 1), flushInterval(flushInterval),
+      head(&stub), tail(&stub), appended(0), written(0), started(false), flushRequested(false), stopping(false), failed(false)
+{
+    stub.next.store(nullptr, std::memory_order_relaxed);
+}
+
+HistoryWriter::~HistoryWriter()
+{
+    if (!worker.joinable()) return; // Nothing was ever appended
+
+    // The background thread drains every remaining record before it exits
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+/*------------
+Producer Side
+-------------*/
+void HistoryWriter::append(HistoryRecord record)
+{
+    std::call_once(opened, [this] { open(); });
+    if (!started.load(std::memory_order_acquire)) return; // The file could not be opened, flush() reports it
+
+    Node* node = new Node;
+    node->record = std::move(record);
+
+    // Counted before the push: the writer can only count a record it popped, so written never passes appended
+    const size_t pending = appended.fetch_add(1, std::memory_order_acq_rel) + 1;
+    push(node);
+
+    // Wake the writer early once a full batch is waiting; otherwise it flushes on its interval
+    if (pending - written.load(std::memory_order_acquire) >= batchSize) wake.notify_one();
+}
+
+void HistoryWriter::flush()
+{
+    if (!started.load(std::memory_order_acquire))
+    {
+        throwIfFailed(); // Never opened, or opening failed
+        return;
+    }
+
+    const size_t target = appended.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    flushRequested = true;
+    wake.notify_one();
+    flushed.wait(lock, [&] { return written.load(std::memory_order_acquire) >= target; });
+    if (!error.empty()) throw std::runtime_error(error);
+}
+
+void HistoryWriter::throwIfFailed()
+{
+    if (!failed.load(std::memory_order_acquire)) return;
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    throw std::runtime_error(error);
+}
+
+void HistoryWriter::open()
+{
+    outFile.open(filename, (format == HISTORY_BINARY) ? std::ios::app | std::ios::binary : std::ios::app);
+    if (!outFile.is_open())
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        error = "Failed to open history file.";
+        failed.store(true, std::memory_order_release);
+        return;
+    }
+    outFile.seekp(0, std::ios::end);
+    if (format == HISTORY_BINARY && outFile.tellp() == 0)
+    {
+        outFile.write(historyFileHeader, historyFileHeaderSize);
+    }
+    worker = std::thread(&HistoryWriter::run, this);
+    started.store(true, std::memory_order_release);
+}
+
+void HistoryWriter::push(Node* node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+/*------------
+Consumer Side
+-------------*/
+HistoryWriter::Node* HistoryWriter::pop()
+{
+    Node* first = tail;
+    Node* next = first->next.load(std::memory_order_acquire);
+    if (first == &stub)
+    {
+        if (next == nullptr) return nullptr; // Empty
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr)
+    {
+        tail = next;
+        return first;
+    }
+    if (first != head.load(std::memory_order_acquire)) return nullptr; // A producer is between exchange and link
+
+    // first is the only node: put the stub back behind it so first can be handed out
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next != nullptr)
+    {
+        tail = next;
+        return first;
+    }
+    return nullptr;
+}
+
+void HistoryWriter::run()
+{
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    while (true)
+    {
+        wake.wait_for(lock, flushInterval, [this]
+        {
+            return stopping || flushRequested ||
+                   appended.load(std::memory_order_acquire) - written.load(std::memory_order_acquire) >= batchSize;
+        });
+        const bool stop = stopping;
+        const bool drain = stop || flushRequested;
+        flushRequested = false;
+        lock.unlock();
+
+        // Write everything queued so far; on shutdown or flush keep going until every appended record is out
+        size_t count = written.load(std::memory_order_relaxed);
+        const size_t target = drain ? appended.load(std::memory_order_acquire) : 0;
+        while (true)
+        {
+            Node* node = pop();
+            if (node == nullptr)
+            {
+                if (count >= target) break;
+                std::this_thread::yield(); // A producer is finishing its push
+                continue;
+            }
+            write(node->record);
+            delete node;
+            count++;
+        }
+        outFile.flush();
+        const bool writeFailed = !outFile; // A failed stream stays failed, later batches are not retried
+
+        lock.lock();
+        if (writeFailed && error.empty())
+        {
+            error = "Failed to write history file.";
+            failed.store(true, std::memory_order_release);
+        }
+        written.store(count, std::memory_order_release);
+        flushed.notify_all();
+        if (stop) break;
+    }
+}
+
+/*-------------
+Record Encoding
+--------------*/
+// Appends the raw bytes of a fixed width field
+template <class Field>
+static void appendField(std::string& buffer, Field field)
+{
+    buffer.append(reinterpret_cast<const char*>(&field), sizeof(field));
+}
+
+// Frames a payload as [uint32 length][uint8 type][payload] and writes it
+static void writeFramed(std::ofstream& outFile, uint8_t type, const std::string& payload)
+{
+    const uint32_t length = static_cast<uint32_t>(1 + payload.size());
+    outFile.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    outFile.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    outFile.write(payload.data(), payload.size());
+}
+
+uint32_t HistoryWriter::internString(const std::string& text)
+{
+    auto found = stringIds.find(text);
+    if (found != stringIds.end()) return found->second;
+
+    const uint32_t id = static_cast<uint32_t>(stringIds.size());
+    stringIds.emplace(text, id);
+    std::string payload;
+    appendField(payload, id);
+    payload += text;
+    writeFramed(outFile, HISTORY_RECORD_STRING, payload);
+    return id;
+}
+
+void HistoryWriter::write(const HistoryRecord& record)
+{
+    if (format == HISTORY_TEXT)
+    {
+        outFile << record.text;
+        return;
+    }
+
+    // Strings first, so the result record only holds ids and fixed width fields
+    const uint32_t expressionId = internString(record.expression);
+    std::vector<uint32_t> nameIds;
+    nameIds.reserve(record.variableNames.size());
+    for (const std::string& name : record.variableNames) nameIds.push_back(internString(name));
+
+    encoded.clear();
+    appendField(encoded, expressionId);
+    appendField(encoded, static_cast<uint8_t>(record.radianMode ? 1 : 0));
+    appendField(encoded, static_cast<int32_t>(record.taylorTerms));
+    appendField(encoded, record.errorThreshold);
+    appendField(encoded, record.result);
+    appendField(encoded, static_cast<uint32_t>(nameIds.size()));
+    for (size_t index = 0; index < nameIds.size(); index++)
+    {
+        appendField(encoded, nameIds[index]);
+        appendField(encoded, index < record.variableValues.size() ? record.variableValues[index] : 0.0);
+    }
+    writeFramed(outFile, HISTORY_RECORD_RESULT, encoded);
+}
@@ -0,0 +1,101 @@
+#ifndef HISTORY_WRITER_H
+#define HISTORY_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// On-disk layout of history records
+enum HistoryFormat
+{
+    HISTORY_TEXT,  // Human readable "Expression:/Tokens:/RPN:/Result:" blocks
+    HISTORY_BINARY // Append-only length-prefixed records, see HistoryReader.h for the layout
+};
+
+// One saved evaluation. Text files only use text; binary files use the structured fields.
+struct HistoryRecord
+{
+    std::string text;
+    std::string expression;
+    std::vector<std::string> variableNames;
+    std::vector<double> variableValues;
+    double result;
+    bool radianMode;
+    int taylorTerms;
+    double errorThreshold;
+};
+
+// Buffered, asynchronous history sink. Callers append finished records to a lock-free queue and return immediately;
+// a background thread keeps the file open and writes records out in batches. Every appended record is written
+// before the writer is destroyed.
+class HistoryWriter
+{
+public:
+    // Records are flushed once batchSize are waiting or flushInterval has passed, whichever comes first
+    HistoryWriter(const std::string& filename, HistoryFormat format = HISTORY_TEXT, size_t batchSize = 64, std::chrono::milliseconds flushInterval = std::chrono::milliseconds(100));
+    ~HistoryWriter();
+
+    HistoryWriter(const HistoryWriter&) = delete;
+    HistoryWriter& operator=(const HistoryWriter&) = delete;
+
+    // Opens the file on first use. Never throws: once the file cannot be opened or written, records are dropped
+    // and the failure is reported by flush() and throwIfFailed().
+    void append(HistoryRecord record);
+    void flush();         // Blocks until every record appended so far is on disk, throws std::runtime_error on failure
+    void throwIfFailed(); // Throws std::runtime_error if opening or writing the file has failed, without blocking
+
+    const std::string& getFilename() const { return filename; }
+    HistoryFormat getFormat() const { return format; }
+
+private:
+    // Multi-producer single-consumer queue (intrusive, Vyukov style): producers only exchange the head pointer
+    struct Node
+    {
+        std::atomic<Node*> next;
+        HistoryRecord record;
+    };
+
+    void push(Node* node);
+    Node* pop(); // Consumer only; may return null while a producer is mid-push
+    void open();
+    void run();  // Background thread
+    void write(const HistoryRecord& record); // Background thread only
+    uint32_t internString(const std::string& text); // Binary format: id of text, defining it in the file when new
+
+    const std::string filename;
+    const HistoryFormat format;
+    const size_t batchSize;
+    const std::chrono::milliseconds flushInterval;
+
+    std::atomic<Node*> head;
+    Node* tail;
+    Node stub;
+
+    std::atomic<size_t> appended; // Records appended so far, counted before they are pushed so written <= appended
+    std::atomic<size_t> written;  // Records written and flushed so far
+
+    std::once_flag opened;
+    std::ofstream outFile;
+    std::unordered_map<std::string, uint32_t> stringIds; // Binary format, strings defined so far by this writer
+    std::string encoded;                                 // Binary format, scratch buffer for one record
+    std::thread worker;
+    std::atomic<bool> started; // Set once worker runs: flush() may race the append that starts it
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;     // Wakes the background thread
+    std::condition_variable flushed;  // Wakes callers waiting in flush()
+    bool flushRequested;
+    bool stopping;
+    std::atomic<bool> failed; // Set once error is, so callers can check without the lock
+    std::string error;        // First open or write failure; guarded by wakeMutex
+};
+
+#endif
@@ -0,0 +1,336 @@
+#include "MathKernels.h"
+#include "ConstMath.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Rows per pass in the block forms, small enough for the temporaries to stay in L1
+static const size_t chunkSize = 256;
+
+// Block form of ConstMath::horner: the coefficient loop is outermost so each step is one vectorizable pass over the rows.
+// Every row sees the same operations in the same order as the scalar form.
+template <int Terms>
+static void hornerBlock(const SeriesCoefficients<Terms>& coefficients, const double* z, double* out, size_t rows)
+{
+    for (size_t row = 0; row < rows; row++) out[row] = coefficients.values[Terms - 1];
+    for (int index = Terms - 2; index >= 0; index--)
+    {
+        const double coefficient = coefficients.values[index];
+        for (size_t row = 0; row < rows; row++) out[row] = out[row] * z[row] + coefficient;
+    }
+}
+
+/*----------
+Exponential
+-----------*/
+// polynomial * 2^k, with overflow, underflow and NaN decided on x
+static inline double expScale(double x, double polynomial, double k)
+{
+    if (!(x <= ConstMath::expOverflow)) return (x != x) ? x : HUGE_VAL;
+    if (x < ConstMath::expUnderflow) return 0;
+    const int exponent = static_cast<int>(k);
+    if (exponent < -1021 || exponent > 1023) return std::ldexp(polynomial, exponent); // Subnormal results and the top binade
+    const uint64_t bits = static_cast<uint64_t>(exponent + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return polynomial * scale;
+}
+
+double MathKernels::exp(double x)
+{
+    double k;
+    const double r = ConstMath::expReduce(x, k);
+    return expScale(x, ConstMath::horner(ConstMath::expCoefficients, r), k);
+}
+
+void MathKernels::expBlock(const double* in, double* out, size_t count)
+{
+    double r[chunkSize], k[chunkSize], polynomial[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++) r[row] = ConstMath::expReduce(in[start + row], k[row]);
+        hornerBlock(ConstMath::expCoefficients, r, polynomial, rows);
+        for (size_t row = 0; row < rows; row++) out[start + row] = expScale(in[start + row], polynomial[row], k[row]);
+    }
+}
+
+/*-------------------
+Logarithms (ln, log)
+--------------------*/
+// x = 2^e * (1 + f) with 1 + f in [sqrt(1/2), sqrt(2)); returns f, which is exact, and sets e. Only called for
+// positive finite x.
+static inline double lnReduce(double x, double& e)
+{
+    int scaleExponent = 0;
+    if (x < 2.2250738585072014e-308) // Subnormal: scale into the normal range first
+    {
+        x *= 18014398509481984.0; // 2^54
+        scaleExponent = -54;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    int exponent = static_cast<int>(bits >> 52) - 1023;
+    bits = (bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull; // Mantissa in [1, 2)
+    double mantissa;
+    std::memcpy(&mantissa, &bits, sizeof(mantissa));
+    if (mantissa > 1.4142135623730951)
+    {
+        mantissa *= 0.5;
+        exponent++;
+    }
+    e = exponent + scaleExponent;
+    return mantissa - 1;
+}
+
+// Shared body of ln and log10
+template <double (*Combine)(double, double)>
+static inline double logarithm(double x)
+{
+    double result;
+    if (ConstMath::lnSpecial(x, result)) return result;
+    double e;
+    const double f = lnReduce(x, e);
+    const double s = f / (2 + f);
+    return Combine(e, ConstMath::lnMantissa(f, s, ConstMath::horner(ConstMath::lnCoefficients, s * s)));
+}
+
+template <double (*Combine)(double, double)>
+static void logarithmBlock(const double* in, double* out, size_t count)
+{
+    double f[chunkSize], s[chunkSize], z[chunkSize], e[chunkSize], series[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++)
+        {
+            const double x = in[start + row];
+            f[row] = (x > 0 && x < HUGE_VAL) ? lnReduce(x, e[row]) : (e[row] = 0);
+        }
+        for (size_t row = 0; row < rows; row++)
+        {
+            s[row] = f[row] / (2 + f[row]);
+            z[row] = s[row] * s[row];
+        }
+        hornerBlock(ConstMath::lnCoefficients, z, series, rows);
+        for (size_t row = 0; row < rows; row++)
+        {
+            double result;
+            if (!ConstMath::lnSpecial(in[start + row], result)) result = Combine(e[row], ConstMath::lnMantissa(f[row], s[row], series[row]));
+            out[start + row] = result;
+        }
+    }
+}
+
+double MathKernels::ln(double x)
+{
+    return logarithm<ConstMath::lnCombine>(x);
+}
+
+double MathKernels::log10(double x)
+{
+    return logarithm<ConstMath::log10Combine>(x);
+}
+
+void MathKernels::lnBlock(const double* in, double* out, size_t count)
+{
+    logarithmBlock<ConstMath::lnCombine>(in, out, count);
+}
+
+void MathKernels::log10Block(const double* in, double* out, size_t count)
+{
+    logarithmBlock<ConstMath::log10Combine>(in, out, count);
+}
+
+/*-------------------------------
+Inverse Trigonometric Functions
+--------------------------------*/
+// ConstMath::atanReduce with std::fabs, which is a single mask where the constexpr abs has to branch
+static inline double atanReduce(double x, int& index)
+{
+    const double magnitude = std::fabs(x);
+    const double t = (magnitude > 1) ? 1 / magnitude : magnitude;
+    index = (t <= 1) ? static_cast<int>(t * 8 + 0.5) : 0; // NaN takes entry 0
+    const double nearest = index * 0.125;
+    return (t - nearest) / (1 + t * nearest);
+}
+
+double MathKernels::atan(double x)
+{
+    int index;
+    const double u = atanReduce(x, index);
+    return ConstMath::atanCombine(x, index, u, ConstMath::horner(ConstMath::atanCoefficients, u * u));
+}
+
+void MathKernels::atanBlock(const double* in, double* out, size_t count)
+{
+    double u[chunkSize], z[chunkSize], series[chunkSize];
+    int index[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++)
+        {
+            u[row] = atanReduce(in[start + row], index[row]);
+            z[row] = u[row] * u[row];
+        }
+        hornerBlock(ConstMath::atanCoefficients, z, series, rows);
+        for (size_t row = 0; row < rows; row++) out[start + row] = ConstMath::atanCombine(in[start + row], index[row], u[row], series[row]);
+    }
+}
+
+// asin and acos go through atan. Near |x| = 1 they use acos(x) = 2 atan(sqrt((1-x)/(1+x))), where 1 - |x| is exact,
+// instead of sqrt(1 - x^2), which is not. |x| > 1 gives NaN through the square root.
+static inline double asinArgument(double x)
+{
+    const double magnitude = std::fabs(x);
+    if (magnitude <= 0.5) return x / std::sqrt((1 - x) * (1 + x));
+    return std::sqrt((1 - magnitude) / (1 + magnitude));
+}
+
+static inline double acosArgument(double x)
+{
+    return std::sqrt((1 - x) / (1 + x));
+}
+
+double MathKernels::asin(double x)
+{
+    return ConstMath::asinCombine(x, atan(asinArgument(x)));
+}
+
+double MathKernels::acos(double x)
+{
+    return 2 * atan(acosArgument(x));
+}
+
+void MathKernels::asinBlock(const double* in, double* out, size_t count)
+{
+    double atanValues[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++) atanValues[row] = asinArgument(in[start + row]);
+        atanBlock(atanValues, atanValues, rows);
+        for (size_t row = 0; row < rows; row++) out[start + row] = ConstMath::asinCombine(in[start + row], atanValues[row]);
+    }
+}
+
+void MathKernels::acosBlock(const double* in, double* out, size_t count)
+{
+    double atanValues[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++) atanValues[row] = acosArgument(in[start + row]);
+        atanBlock(atanValues, atanValues, rows);
+        for (size_t row = 0; row < rows; row++) out[start + row] = 2 * atanValues[row];
+    }
+}
+
+/*-------------------
+Hyperbolic Functions
+--------------------*/
+// |x| < 1 uses the series for sinh, where e^x - e^-x would cancel; larger arguments go through exp(|x|), and past
+// the point where exp overflows through exp(|x|/2)^2 / 2
+static inline double sinhCombine(double x, double expValue, double series)
+{
+    const double magnitude = std::fabs(x);
+    if (magnitude < 1) return ConstMath::sinhSmall(x, series);
+    double result;
+    if (magnitude <= ConstMath::expOverflow) result = 0.5 * (expValue - 1 / expValue);
+    else
+    {
+        const double half = MathKernels::exp(0.5 * magnitude); // NaN stays NaN
+        result = (0.5 * half) * half;
+    }
+    return (x < 0) ? -result : result;
+}
+
+static inline double coshCombine(double x, double expValue)
+{
+    const double magnitude = std::fabs(x);
+    if (magnitude <= ConstMath::expOverflow) return 0.5 * (expValue + 1 / expValue);
+    const double half = MathKernels::exp(0.5 * magnitude);
+    return (0.5 * half) * half;
+}
+
+// tanh(x) = sinh/sqrt(1 + sinh^2) below 1, 1 - 2/(e^2|x| + 1) up to 22 and +-1 past that
+static inline double tanhCombine(double x, double expTwice, double series)
+{
+    const double magnitude = std::fabs(x);
+    double result;
+    if (magnitude < 1)
+    {
+        const double sinhValue = ConstMath::sinhSmall(magnitude, series);
+        result = sinhValue / std::sqrt(1 + sinhValue * sinhValue);
+    }
+    else if (magnitude > 22) result = 1;
+    else result = 1 - 2 / (expTwice + 1); // NaN stays NaN
+    return (x < 0) ? -result : result;
+}
+
+double MathKernels::sinh(double x)
+{
+    const double magnitude = std::fabs(x);
+    if (magnitude < 1) return ConstMath::sinhSmall(x, ConstMath::horner(ConstMath::sinhCoefficients, x * x));
+    return sinhCombine(x, exp(magnitude), 0);
+}
+
+double MathKernels::cosh(double x)
+{
+    return coshCombine(x, exp(std::fabs(x)));
+}
+
+double MathKernels::tanh(double x)
+{
+    const double magnitude = std::fabs(x);
+    if (magnitude < 1) return tanhCombine(x, 0, ConstMath::horner(ConstMath::sinhCoefficients, x * x));
+    return tanhCombine(x, exp(2 * magnitude), 0);
+}
+
+void MathKernels::sinhBlock(const double* in, double* out, size_t count)
+{
+    double expValues[chunkSize], z[chunkSize], series[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++)
+        {
+            expValues[row] = std::fabs(in[start + row]);
+            z[row] = in[start + row] * in[start + row];
+        }
+        expBlock(expValues, expValues, rows);
+        hornerBlock(ConstMath::sinhCoefficients, z, series, rows);
+        for (size_t row = 0; row < rows; row++) out[start + row] = sinhCombine(in[start + row], expValues[row], series[row]);
+    }
+}
+
+void MathKernels::coshBlock(const double* in, double* out, size_t count)
+{
+    double expValues[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++) expValues[row] = std::fabs(in[start + row]);
+        expBlock(expValues, expValues, rows);
+        for (size_t row = 0; row < rows; row++) out[start + row] = coshCombine(in[start + row], expValues[row]);
+    }
+}
+
+void MathKernels::tanhBlock(const double* in, double* out, size_t count)
+{
+    double expValues[chunkSize], z[chunkSize], series[chunkSize];
+    for (size_t start = 0; start < count; start += chunkSize)
+    {
+        const size_t rows = (count - start < chunkSize) ? count - start : chunkSize;
+        for (size_t row = 0; row < rows; row++)
+        {
+            expValues[row] = 2 * std::fabs(in[start + row]);
+            z[row] = in[start + row] * in[start + row];
+        }
+        expBlock(expValues, expValues, rows);
+        hornerBlock(ConstMath::sinhCoefficients, z, series, rows);
+        for (size_t row = 0; row < rows; row++) out[start + row] = tanhCombine(in[start + row], expValues[row], series[row]);
+    }
+}
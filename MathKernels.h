@@ -0,0 +1,41 @@
+#ifndef MATH_KERNELS_H
+#define MATH_KERNELS_H
+
+#include <cstddef>
+
+// In-house elementary functions behind the expression language's exp, ln, log, asin, acos, atan, sinh, cosh and tanh.
+// Each one reduces its argument to a small range and runs a short series there with Horner's rule, the same way the
+// trig functions do, to within 3 units in the last place (calculator_bench --accuracy measures them against
+// libm). Arguments outside a function's domain give NaN; Calculator applies its errorThreshold rules on top.
+//
+// The block forms compute count values at once: every step runs across the whole block before the next, so the
+// reduction and series loops vectorize. They give exactly the scalar results, and in may alias out.
+class MathKernels
+{
+public:
+    static double exp(double x);
+    static double ln(double x);
+    static double log10(double x);
+    static double atan(double x);
+    static double asin(double x);
+    static double acos(double x);
+    static double sinh(double x);
+    static double cosh(double x);
+    static double tanh(double x);
+
+    // min and max of the expression language: NaN when either argument is NaN, unlike std::fmin and std::fmax
+    static constexpr double minimum(double a, double b) { return (a != a || a < b) ? a : b; }
+    static constexpr double maximum(double a, double b) { return (a != a || a > b) ? a : b; }
+
+    static void expBlock(const double* in, double* out, size_t count);
+    static void lnBlock(const double* in, double* out, size_t count);
+    static void log10Block(const double* in, double* out, size_t count);
+    static void atanBlock(const double* in, double* out, size_t count);
+    static void asinBlock(const double* in, double* out, size_t count);
+    static void acosBlock(const double* in, double* out, size_t count);
+    static void sinhBlock(const double* in, double* out, size_t count);
+    static void coshBlock(const double* in, double* out, size_t count);
+    static void tanhBlock(const double* in, double* out, size_t count);
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "Metrics.h"
+#include "Calculator.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+static const char* const stageNames[STAGE_COUNT] = {"parse", "evaluate_rpn", "save_history"};
+
+// Prometheus label for each EvalStatus
+static const char* const errorClassNames[] = {
+    "none", "division_by_zero", "tan_undefined", "domain_error", "invalid_expression", "invalid_number",
+    "multiple_decimal_points", "unknown_name", "unknown_character", "missing_left_paren", "missing_right_paren",
+    "missing_operand", "extra_operand", "argument_count", "missing_values"};
+static_assert(sizeof(errorClassNames) / sizeof(errorClassNames[0]) == Calculator::EVAL_MISSING_VALUES + 1, "every EvalStatus needs a label");
+static_assert(Calculator::EVAL_MISSING_VALUES < metricsErrorClassCount, "metricsErrorClassCount is too small");
+
+static std::atomic<uint64_t> nextMetricsId(1);
+
+Metrics::Metrics() : id(nextMetricsId.fetch_add(1, std::memory_order_relaxed))
+{
+    std::memset(&baseline, 0, sizeof(baseline));
+}
+
+Metrics::Shard& Metrics::localShard()
+{
+    struct Entry
+    {
+        uint64_t metricsId;
+        Shard* shard;
+    };
+    static thread_local Entry last = {0, nullptr};
+    static thread_local std::vector<Entry> entries; // This thread's shard in every instance it has recorded to
+    if (last.metricsId == id) return *last.shard;
+    for (const Entry& entry : entries)
+    {
+        if (entry.metricsId == id)
+        {
+            last = entry;
+            return *entry.shard;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    shards.push_back(std::unique_ptr<Shard>(new Shard));
+    Shard& shard = *shards.back();
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        shard.stageCount[stage].store(0, std::memory_order_relaxed);
+        shard.stageSum[stage].store(0, std::memory_order_relaxed);
+        for (std::atomic<uint64_t>& bucket : shard.buckets[stage]) bucket.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint64_t>& counter : shard.counters) counter.store(0, std::memory_order_relaxed);
+    for (std::atomic<uint64_t>& error : shard.errors) error.store(0, std::memory_order_relaxed);
+
+    last = Entry{id, &shard};
+    entries.push_back(last);
+    return shard;
+}
+
+// Only the owning thread writes a shard, so a relaxed load and store cannot lose an update
+static void increment(std::atomic<uint64_t>& value, uint64_t amount)
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+/*------------
+Recording
+-------------*/
+Metrics::Clock::time_point Metrics::record(MetricsStage stage, Clock::time_point start)
+{
+    const Clock::time_point end = Clock::now();
+    const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    const uint64_t nanoseconds = (elapsed > 0) ? static_cast<uint64_t>(elapsed) : 0;
+
+    size_t bucket = 0; // Smallest b with nanoseconds < 2^b
+    while (bucket < metricsBucketCount - 1 && (nanoseconds >> bucket) != 0) bucket++;
+
+    Shard& shard = localShard();
+    increment(shard.stageCount[stage], 1);
+    increment(shard.stageSum[stage], nanoseconds);
+    increment(shard.buckets[stage][bucket], 1);
+    return end;
+}
+
+void Metrics::count(MetricsCounter counter, uint64_t amount)
+{
+    increment(localShard().counters[counter], amount);
+}
+
+void Metrics::countError(unsigned char status)
+{
+    if (status < metricsErrorClassCount) increment(localShard().errors[status], 1);
+}
+
+MetricsSnapshot Metrics::total() const
+{
+    MetricsSnapshot snapshot;
+    std::memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.enabled = true;
+    for (const std::unique_ptr<Shard>& shard : shards)
+    {
+        for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            snapshot.stages[stage].count += shard->stageCount[stage].load(std::memory_order_relaxed);
+            snapshot.stages[stage].sumNanoseconds += shard->stageSum[stage].load(std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < metricsBucketCount; bucket++)
+            {
+                snapshot.stages[stage].buckets[bucket] += shard->buckets[stage][bucket].load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t counter = 0; counter < COUNTER_COUNT; counter++) snapshot.counters[counter] += shard->counters[counter].load(std::memory_order_relaxed);
+        for (size_t status = 0; status < metricsErrorClassCount; status++) snapshot.errors[status] += shard->errors[status].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+MetricsSnapshot Metrics::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    MetricsSnapshot snapshot = total();
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        snapshot.stages[stage].count -= baseline.stages[stage].count;
+        snapshot.stages[stage].sumNanoseconds -= baseline.stages[stage].sumNanoseconds;
+        for (size_t bucket = 0; bucket < metricsBucketCount; bucket++) snapshot.stages[stage].buckets[bucket] -= baseline.stages[stage].buckets[bucket];
+    }
+    for (size_t counter = 0; counter < COUNTER_COUNT; counter++) snapshot.counters[counter] -= baseline.counters[counter];
+    for (size_t status = 0; status < metricsErrorClassCount; status++) snapshot.errors[status] -= baseline.errors[status];
+    return snapshot;
+}
+
+void Metrics::reset()
+{
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    baseline = total();
+}
+
+/*------------
+Export
+-------------*/
+double StageHistogram::quantileNanoseconds(double quantile) const
+{
+    if (count == 0) return 0;
+    const double target = quantile * count;
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < metricsBucketCount; bucket++)
+    {
+        seen += buckets[bucket];
+        if (seen >= target) return static_cast<double>(static_cast<uint64_t>(1) << bucket);
+    }
+    return static_cast<double>(static_cast<uint64_t>(1) << (metricsBucketCount - 1));
+}
+
+// Appends printf-formatted text
+static void appendFormat(std::string& text, const char* format, ...)
+{
+    char line[256];
+    va_list arguments;
+    va_start(arguments, format);
+    const int length = std::vsnprintf(line, sizeof(line), format, arguments);
+    va_end(arguments);
+    if (length > 0) text.append(line, (static_cast<size_t>(length) < sizeof(line)) ? static_cast<size_t>(length) : sizeof(line) - 1);
+}
+
+std::string MetricsSnapshot::toPrometheus() const
+{
+    std::string text;
+    text += "# HELP calculator_stage_duration_seconds Time spent in each stage of string evaluation.\n";
+    text += "# TYPE calculator_stage_duration_seconds histogram\n";
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        const StageHistogram& histogram = stages[stage];
+        uint64_t cumulative = 0;
+        for (size_t bucket = 0; bucket + 1 < metricsBucketCount; bucket++)
+        {
+            cumulative += histogram.buckets[bucket];
+            appendFormat(text, "calculator_stage_duration_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %llu\n", stageNames[stage],
+                         static_cast<double>(static_cast<uint64_t>(1) << bucket) * 1e-9, static_cast<unsigned long long>(cumulative));
+        }
+        appendFormat(text, "calculator_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", stageNames[stage], static_cast<unsigned long long>(histogram.count));
+        appendFormat(text, "calculator_stage_duration_seconds_sum{stage=\"%s\"} %.9g\n", stageNames[stage], histogram.sumNanoseconds * 1e-9);
+        appendFormat(text, "calculator_stage_duration_seconds_count{stage=\"%s\"} %llu\n", stageNames[stage], static_cast<unsigned long long>(histogram.count));
+    }
+
+    text += "# HELP calculator_evaluations_total Expressions taken through the string pipeline.\n";
+    text += "# TYPE calculator_evaluations_total counter\n";
+    appendFormat(text, "calculator_evaluations_total %llu\n", static_cast<unsigned long long>(counters[COUNTER_EVALUATIONS]));
+
+    text += "# HELP calculator_solver_iterations_total Iterative TVM solver steps.\n";
+    text += "# TYPE calculator_solver_iterations_total counter\n";
+    appendFormat(text, "calculator_solver_iterations_total{solver=\"interest\"} %llu\n", static_cast<unsigned long long>(counters[COUNTER_INTEREST_ITERATIONS]));
+    appendFormat(text, "calculator_solver_iterations_total{solver=\"periods\"} %llu\n", static_cast<unsigned long long>(counters[COUNTER_PERIODS_ITERATIONS]));
+
+    text += "# HELP calculator_solver_not_converged_total Iterative TVM solves that did not converge.\n";
+    text += "# TYPE calculator_solver_not_converged_total counter\n";
+    appendFormat(text, "calculator_solver_not_converged_total{solver=\"interest\"} %llu\n", static_cast<unsigned long long>(counters[COUNTER_INTEREST_NOT_CONVERGED]));
+    appendFormat(text, "calculator_solver_not_converged_total{solver=\"periods\"} %llu\n", static_cast<unsigned long long>(counters[COUNTER_PERIODS_NOT_CONVERGED]));
+
+    text += "# HELP calculator_result_cache_lookups_total Result cache lookups.\n";
+    text += "# TYPE calculator_result_cache_lookups_total counter\n";
+    appendFormat(text, "calculator_result_cache_lookups_total{result=\"hit\"} %llu\n", static_cast<unsigned long long>(counters[COUNTER_CACHE_HITS]));
+    appendFormat(text, "calculator_result_cache_lookups_total{result=\"miss\"} %llu\n", static_cast<unsigned long long>(counters[COUNTER_CACHE_MISSES]));
+
+    text += "# HELP calculator_errors_total Failed evaluations by error class.\n";
+    text += "# TYPE calculator_errors_total counter\n";
+    for (size_t status = 1; status <= Calculator::EVAL_MISSING_VALUES; status++)
+    {
+        appendFormat(text, "calculator_errors_total{class=\"%s\"} %llu\n", errorClassNames[status], static_cast<unsigned long long>(errors[status]));
+    }
+    return text;
+}
+
+std::string MetricsSnapshot::toText() const
+{
+    if (!enabled) return "Metrics are not enabled in this build (CALCULATOR_METRICS).\n";
+
+    std::string text;
+    for (size_t stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        const StageHistogram& histogram = stages[stage];
+        appendFormat(text, "%-15s count %llu  mean %.0f ns  p50 < %.0f ns  p99 < %.0f ns\n", stageNames[stage],
+                     static_cast<unsigned long long>(histogram.count), histogram.count ? static_cast<double>(histogram.sumNanoseconds) / histogram.count : 0.0,
+                     histogram.quantileNanoseconds(0.5), histogram.quantileNanoseconds(0.99));
+    }
+    appendFormat(text, "evaluations %llu, cache hits %llu, misses %llu\n", static_cast<unsigned long long>(counters[COUNTER_EVALUATIONS]),
+                 static_cast<unsigned long long>(counters[COUNTER_CACHE_HITS]), static_cast<unsigned long long>(counters[COUNTER_CACHE_MISSES]));
+    appendFormat(text, "interest: %llu iterations, %llu not converged; periods: %llu iterations, %llu not converged\n",
+                 static_cast<unsigned long long>(counters[COUNTER_INTEREST_ITERATIONS]), static_cast<unsigned long long>(counters[COUNTER_INTEREST_NOT_CONVERGED]),
+                 static_cast<unsigned long long>(counters[COUNTER_PERIODS_ITERATIONS]), static_cast<unsigned long long>(counters[COUNTER_PERIODS_NOT_CONVERGED]));
+    for (size_t status = 1; status <= Calculator::EVAL_MISSING_VALUES; status++)
+    {
+        if (errors[status] != 0) appendFormat(text, "errors %s: %llu\n", errorClassNames[status], static_cast<unsigned long long>(errors[status]));
+    }
+    return text;
+}
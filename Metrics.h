@@ -0,0 +1,115 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timed stages of string evaluation
+enum MetricsStage
+{
+    STAGE_PARSE,        // parseToRPN, tokenize and convertToRPN fused
+    STAGE_EVALUATE_RPN,
+    STAGE_SAVE_HISTORY,
+    STAGE_COUNT
+};
+
+enum MetricsCounter
+{
+    COUNTER_EVALUATIONS,             // Expressions taken through the string pipeline
+    COUNTER_INTEREST_ITERATIONS,     // Solver steps in calculateInterest / calculateInterestBatch
+    COUNTER_INTEREST_NOT_CONVERGED,
+    COUNTER_PERIODS_ITERATIONS,      // Newton steps in calculateNumberOfPeriods when the closed form does not apply
+    COUNTER_PERIODS_NOT_CONVERGED,
+    COUNTER_CACHE_HITS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_COUNT
+};
+
+const size_t metricsBucketCount = 32;     // Bucket b holds durations below 2^b ns, the last one everything longer
+const size_t metricsErrorClassCount = 16; // Indexed by Calculator::EvalStatus
+
+// Latency distribution of one stage
+struct StageHistogram
+{
+    uint64_t count;
+    uint64_t sumNanoseconds;
+    uint64_t buckets[metricsBucketCount];
+
+    double quantileNanoseconds(double quantile) const; // Upper bound of the bucket holding the quantile
+};
+
+// Point in time copy of every metric
+struct MetricsSnapshot
+{
+    bool enabled; // False when built without CALCULATOR_METRICS, everything else is then zero
+    StageHistogram stages[STAGE_COUNT];
+    uint64_t counters[COUNTER_COUNT];
+    uint64_t errors[metricsErrorClassCount];
+
+    std::string toPrometheus() const; // Prometheus text exposition format
+    std::string toText() const;       // Human readable summary
+};
+
+// Metrics store. Each thread that records gets its own shard and is the only writer to it, so recording is a
+// relaxed load and store per value, with no locked instructions and no contention between threads; snapshot()
+// sums the shards.
+class Metrics
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    Metrics();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    Clock::time_point record(MetricsStage stage, Clock::time_point start); // Returns the end time, so back to back stages share one clock read
+    void count(MetricsCounter counter, uint64_t amount = 1);
+    void countError(unsigned char status);
+
+    MetricsSnapshot snapshot() const;
+    void reset(); // Later snapshots count from here; safe while other threads record
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> stageCount[STAGE_COUNT];
+        std::atomic<uint64_t> stageSum[STAGE_COUNT];
+        std::atomic<uint64_t> buckets[STAGE_COUNT][metricsBucketCount];
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+        std::atomic<uint64_t> errors[metricsErrorClassCount];
+    };
+
+    Shard& localShard();
+    MetricsSnapshot total() const; // Caller holds shardsMutex
+
+    const uint64_t id; // Never reused, unlike addresses, so a thread's shard lookup cannot hit a dead instance
+    mutable std::mutex shardsMutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+    MetricsSnapshot baseline; // Totals at the last reset()
+};
+
+// Instrumentation points. Built without CALCULATOR_METRICS they expand to nothing, so the evaluation paths carry
+// no timing calls, branches or atomics. metrics is a (smart) pointer that may be null. RECORD moves start to the
+// end of the stage it timed, so the next stage can be recorded against the same variable.
+#ifdef CALCULATOR_METRICS
+#define CALCULATOR_METRICS_START(name) Metrics::Clock::time_point name = Metrics::Clock::now()
+#define CALCULATOR_METRICS_RESTART(name) name = Metrics::Clock::now()
+#define CALCULATOR_METRICS_RECORD(metrics, stage, start) do { if (metrics) start = (metrics)->record(stage, start); } while (0)
+#define CALCULATOR_METRICS_COUNT(metrics, counter, amount) do { if (metrics) (metrics)->count(counter, amount); } while (0)
+#define CALCULATOR_METRICS_ERROR(metrics, status) do { if (metrics) (metrics)->countError(status); } while (0)
+#else
+#define CALCULATOR_METRICS_START(name) do { } while (0)
+#define CALCULATOR_METRICS_RESTART(name) do { } while (0)
+#define CALCULATOR_METRICS_RECORD(metrics, stage, start) do { } while (0)
+#define CALCULATOR_METRICS_COUNT(metrics, counter, amount) do { } while (0)
+#define CALCULATOR_METRICS_ERROR(metrics, status) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,350 @@
+#include "NativeCompiler.h"
+#include "MathKernels.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define NATIVE_COMPILER_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+NativeProgram::NativeProgram(void* code, size_t size) : code(code), size(size)
+{
+    std::memcpy(&entry, &code, sizeof(entry)); // Object to function pointer, as dlsym does
+}
+
+NativeProgram::~NativeProgram()
+{
+#ifdef NATIVE_COMPILER_X86_64
+    ::munmap(code, size);
+#endif
+}
+
+/*------------
+Runtime Helpers
+-------------*/
+// Generated code has no unwind information, so nothing called from it may throw
+double NativeCompiler::sinHelper(double angle, NativeContext* context)
+{
+    return context->calculator->calcSin(angle, *context->settings);
+}
+
+double NativeCompiler::cosHelper(double angle, NativeContext* context)
+{
+    return context->calculator->calcCos(angle, *context->settings);
+}
+
+double NativeCompiler::tanHelper(double angle, NativeContext* context)
+{
+    double sinValue, cosValue;
+    context->calculator->calcSinCos(angle, sinValue, cosValue, *context->settings); // Same rule as evaluateRPN
+    if (std::fabs(cosValue) < context->settings->errorThreshold)
+    {
+        context->status = Calculator::EVAL_TAN_UNDEFINED;
+        return 0;
+    }
+    return sinValue / cosValue;
+}
+
+double NativeCompiler::powHelper(double base, double exponent)
+{
+    return std::pow(base, exponent);
+}
+
+double NativeCompiler::functionHelper(double x, NativeContext* context, int function)
+{
+    const Calculator::EvalStatus status = context->calculator->applyFunction(static_cast<Calculator::OpCode>(function), x, *context->settings);
+    if (status == Calculator::EVAL_OK) return x;
+    context->status = status;
+    return 0;
+}
+
+void NativeCompiler::extremumHelper(double* values, int count, int maximum)
+{
+    for (int index = 1; index < count; index++)
+    {
+        values[0] = maximum ? MathKernels::maximum(values[0], values[index]) : MathKernels::minimum(values[0], values[index]);
+    }
+}
+
+#ifdef NATIVE_COMPILER_X86_64
+
+/*------------
+x86-64 Emitter
+-------------*/
+namespace
+{
+// Register assignment: stack entry k lives in xmm(firstStackRegister + k); xmm0 and xmm1 carry helper arguments
+// and scratch values, xmm15 holds the sign mask for negation. rbx keeps the variable array, r12 the context and
+// r13 the result pointer across helper calls.
+const int firstStackRegister = 2;
+const int stackRegisterCount = 13;
+const int signMaskRegister = 15;
+const int spillAreaSize = 112; // stackRegisterCount doubles, rounded up to keep rsp 16-byte aligned at calls
+
+const int RAX = 0, RSP = 4, RBX = 3;
+const int R12 = 12;
+
+class Emitter
+{
+public:
+    std::vector<unsigned char> code;
+
+    void byte(unsigned char value) { code.push_back(value); }
+    void bytes(std::initializer_list<unsigned char> values) { code.insert(code.end(), values); }
+
+    void int32(int32_t value)
+    {
+        const unsigned char* raw = reinterpret_cast<const unsigned char*>(&value);
+        code.insert(code.end(), raw, raw + sizeof(value));
+    }
+
+    void int64(uint64_t value)
+    {
+        const unsigned char* raw = reinterpret_cast<const unsigned char*>(&value);
+        code.insert(code.end(), raw, raw + sizeof(value));
+    }
+
+    // prefix [REX] 0F opcode with register-direct ModRM, for the scalar double SSE2 instructions
+    void sse(unsigned char prefix, unsigned char opcode, int reg, int rm)
+    {
+        byte(prefix);
+        if (reg >= 8 || rm >= 8) byte(0x40 | ((reg >= 8) ? 4 : 0) | ((rm >= 8) ? 1 : 0));
+        bytes({0x0F, opcode, static_cast<unsigned char>(0xC0 | ((reg & 7) << 3) | (rm & 7))});
+    }
+
+    // prefix [REX] 0F opcode with a [base + disp32] operand; rsp and r12 bases need a SIB byte
+    void sseMemory(unsigned char prefix, unsigned char opcode, int reg, int base, int32_t displacement)
+    {
+        byte(prefix);
+        if (reg >= 8 || base >= 8) byte(0x40 | ((reg >= 8) ? 4 : 0) | ((base >= 8) ? 1 : 0));
+        bytes({0x0F, opcode, static_cast<unsigned char>(0x80 | ((reg & 7) << 3) | (base & 7))});
+        if ((base & 7) == RSP) byte(0x24);
+        int32(displacement);
+    }
+
+    void movsd(int destination, int source) { if (destination != source) sse(0xF2, 0x10, destination, source); }
+    void loadDouble(int destination, int base, int32_t displacement) { sseMemory(0xF2, 0x10, destination, base, displacement); }
+    void storeDouble(int base, int32_t displacement, int source) { sseMemory(0xF2, 0x11, source, base, displacement); }
+
+    // mov rax, bits; movq xmm, rax
+    void loadConstant(int destination, uint64_t bits)
+    {
+        bytes({0x48, 0xB8});
+        int64(bits);
+        bytes({0x66, static_cast<unsigned char>(0x48 | ((destination >= 8) ? 4 : 0)), 0x0F, 0x6E, static_cast<unsigned char>(0xC0 | ((destination & 7) << 3))});
+    }
+
+    void loadConstant(int destination, double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        loadConstant(destination, bits);
+    }
+
+    // mov rax, target; call rax
+    void call(const void* target)
+    {
+        uint64_t address;
+        std::memcpy(&address, &target, sizeof(address));
+        bytes({0x48, 0xB8});
+        int64(address);
+        bytes({0xFF, 0xD0});
+    }
+
+    // Conditional (0F 8x) or unconditional (E9) rel32 jump; returns the displacement's offset for patching
+    size_t jump(unsigned char condition)
+    {
+        if (condition == 0) byte(0xE9);
+        else bytes({0x0F, condition});
+        int32(0);
+        return code.size() - 4;
+    }
+
+    void patch(size_t displacementOffset, size_t target)
+    {
+        const int32_t displacement = static_cast<int32_t>(target - (displacementOffset + 4));
+        std::memcpy(&code[displacementOffset], &displacement, sizeof(displacement));
+    }
+};
+
+const unsigned char JUMP = 0, JNE = 0x85, JP = 0x8A;
+
+int stackRegister(int entry)
+{
+    return firstStackRegister + entry;
+}
+
+// Saves the entries below firstArgument, which a call would clobber (every xmm register is caller saved)
+void spill(Emitter& emitter, int firstArgument)
+{
+    for (int entry = 0; entry < firstArgument; entry++) emitter.storeDouble(RSP, entry * 8, stackRegister(entry));
+}
+
+void restore(Emitter& emitter, int firstArgument)
+{
+    for (int entry = 0; entry < firstArgument; entry++) emitter.loadDouble(stackRegister(entry), RSP, entry * 8);
+    emitter.loadConstant(signMaskRegister, static_cast<uint64_t>(1) << 63);
+}
+}
+
+/*--------------
+Code Generation
+---------------*/
+std::shared_ptr<const NativeProgram> NativeCompiler::compile(const std::vector<Calculator::Token>& rpnProgram, int maxStackDepth)
+{
+    if (rpnProgram.empty() || maxStackDepth > stackRegisterCount) return nullptr;
+
+    const int32_t statusOffset = static_cast<int32_t>(offsetof(NativeContext, status));
+    Emitter emitter;
+    std::vector<size_t> exits; // Jumps to the error exit
+
+    // Prologue: int entry(const double* variableValues (rdi), double* result (rsi), NativeContext* context (rdx))
+    emitter.bytes({0x53, 0x41, 0x54, 0x41, 0x55});       // push rbx; push r12; push r13
+    emitter.bytes({0x48, 0x89, 0xFB});                   // mov rbx, rdi
+    emitter.bytes({0x49, 0x89, 0xF5});                   // mov r13, rsi
+    emitter.bytes({0x49, 0x89, 0xD4});                   // mov r12, rdx
+    emitter.bytes({0x48, 0x81, 0xEC});                   // sub rsp, spillAreaSize
+    emitter.int32(spillAreaSize);
+    emitter.loadConstant(signMaskRegister, static_cast<uint64_t>(1) << 63);
+
+    // Operand counts were validated by validateRPN, so the stack never underflows
+    int top = -1;
+    for (const Calculator::Token& token : rpnProgram)
+    {
+        switch (token.opcode)
+        {
+            case Calculator::OP_NUMBER: top++; emitter.loadConstant(stackRegister(top), token.number); break;
+            case Calculator::OP_VARIABLE: top++; emitter.loadDouble(stackRegister(top), RBX, token.slot * 8); break;
+            case Calculator::OP_ADD: top--; emitter.sse(0xF2, 0x58, stackRegister(top), stackRegister(top + 1)); break;
+            case Calculator::OP_SUBTRACT: top--; emitter.sse(0xF2, 0x5C, stackRegister(top), stackRegister(top + 1)); break;
+            case Calculator::OP_MULTIPLY: top--; emitter.sse(0xF2, 0x59, stackRegister(top), stackRegister(top + 1)); break;
+            case Calculator::OP_DIVIDE:
+            {
+                top--;
+                // A zero divisor exits with EVAL_DIVISION_BY_ZERO; NaN compares unordered and divides as usual
+                emitter.sse(0x66, 0x57, 0, 0);                            // xorpd xmm0, xmm0
+                emitter.sse(0x66, 0x2E, stackRegister(top + 1), 0);        // ucomisd divisor, xmm0
+                const size_t unordered = emitter.jump(JP);
+                const size_t nonZero = emitter.jump(JNE);
+                emitter.bytes({0x41, 0xC6, 0x84, 0x24});                 // mov byte [r12 + status], EVAL_DIVISION_BY_ZERO
+                emitter.int32(statusOffset);
+                emitter.byte(Calculator::EVAL_DIVISION_BY_ZERO);
+                exits.push_back(emitter.jump(JUMP));
+                emitter.patch(unordered, emitter.code.size());
+                emitter.patch(nonZero, emitter.code.size());
+                emitter.sse(0xF2, 0x5E, stackRegister(top), stackRegister(top + 1));
+                break;
+            }
+            case Calculator::OP_POWER:
+                top--;
+                spill(emitter, top);
+                emitter.movsd(0, stackRegister(top));
+                emitter.movsd(1, stackRegister(top + 1));
+                emitter.call(reinterpret_cast<const void*>(&NativeCompiler::powHelper));
+                emitter.movsd(stackRegister(top), 0);
+                restore(emitter, top);
+                break;
+            case Calculator::OP_NEGATE: emitter.sse(0x66, 0x57, stackRegister(top), signMaskRegister); break; // xorpd
+            case Calculator::OP_SIN:
+            case Calculator::OP_COS:
+            case Calculator::OP_TAN:
+            {
+                const void* helper = (token.opcode == Calculator::OP_SIN) ? reinterpret_cast<const void*>(&NativeCompiler::sinHelper)
+                                   : (token.opcode == Calculator::OP_COS) ? reinterpret_cast<const void*>(&NativeCompiler::cosHelper)
+                                                                          : reinterpret_cast<const void*>(&NativeCompiler::tanHelper);
+                spill(emitter, top);
+                emitter.movsd(0, stackRegister(top));
+                emitter.bytes({0x4C, 0x89, 0xE7});                       // mov rdi, r12
+                emitter.call(helper);
+                emitter.movsd(stackRegister(top), 0);
+                restore(emitter, top);
+                if (token.opcode == Calculator::OP_TAN)
+                {
+                    emitter.bytes({0x41, 0x80, 0xBC, 0x24});             // cmp byte [r12 + status], 0
+                    emitter.int32(statusOffset);
+                    emitter.byte(0);
+                    exits.push_back(emitter.jump(JNE));
+                }
+                break;
+            }
+            case Calculator::OP_EXP:
+            case Calculator::OP_LN:
+            case Calculator::OP_LOG:
+            case Calculator::OP_SQRT:
+            case Calculator::OP_ABS:
+            case Calculator::OP_ASIN:
+            case Calculator::OP_ACOS:
+            case Calculator::OP_ATAN:
+            case Calculator::OP_SINH:
+            case Calculator::OP_COSH:
+            case Calculator::OP_TANH:
+                spill(emitter, top);
+                emitter.movsd(0, stackRegister(top));
+                emitter.bytes({0x4C, 0x89, 0xE7});                       // mov rdi, r12
+                emitter.byte(0xBE);                                      // mov esi, opcode
+                emitter.int32(token.opcode);
+                emitter.call(reinterpret_cast<const void*>(&NativeCompiler::functionHelper));
+                emitter.movsd(stackRegister(top), 0);
+                restore(emitter, top);
+                emitter.bytes({0x41, 0x80, 0xBC, 0x24});                 // cmp byte [r12 + status], 0
+                emitter.int32(statusOffset);
+                emitter.byte(0);
+                exits.push_back(emitter.jump(JNE));
+                break;
+            case Calculator::OP_MIN:
+            case Calculator::OP_MAX:
+            {
+                // The arguments go through the spill area, which then already holds everything below them
+                const int first = top - (token.slot - 1);
+                spill(emitter, top + 1);
+                emitter.bytes({0x48, 0x8D, 0xBC, 0x24});                 // lea rdi, [rsp + first * 8]
+                emitter.int32(first * 8);
+                emitter.byte(0xBE);                                      // mov esi, count
+                emitter.int32(token.slot);
+                emitter.byte(0xBA);                                      // mov edx, maximum
+                emitter.int32(token.opcode == Calculator::OP_MAX);
+                emitter.call(reinterpret_cast<const void*>(&NativeCompiler::extremumHelper));
+                top = first;
+                restore(emitter, top + 1);
+                break;
+            }
+            default: return nullptr; // Parentheses and commas never reach the RPN program
+        }
+    }
+
+    emitter.storeDouble(13, 0, stackRegister(0));                  // movsd [r13], result
+
+    // Exit: return context->status
+    for (size_t exit : exits) emitter.patch(exit, emitter.code.size());
+    emitter.bytes({0x41, 0x0F, 0xB6, 0x84, 0x24});                 // movzx eax, byte [r12 + status]
+    emitter.int32(statusOffset);
+    emitter.bytes({0x48, 0x81, 0xC4});                             // add rsp, spillAreaSize
+    emitter.int32(spillAreaSize);
+    emitter.bytes({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});           // pop r13; pop r12; pop rbx; ret
+
+    // Written through a writable mapping, then flipped to read + execute so no page is ever both
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t size = (emitter.code.size() + pageSize - 1) / pageSize * pageSize;
+    void* code = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) return nullptr;
+    std::memcpy(code, emitter.code.data(), emitter.code.size());
+    if (::mprotect(code, size, PROT_READ | PROT_EXEC) != 0)
+    {
+        ::munmap(code, size);
+        return nullptr;
+    }
+    return std::make_shared<const NativeProgram>(code, size);
+}
+
+#else
+
+std::shared_ptr<const NativeProgram> NativeCompiler::compile(const std::vector<Calculator::Token>&, int)
+{
+    return nullptr; // No backend for this platform, the interpreter runs every program
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef NATIVE_COMPILER_H
+#define NATIVE_COMPILER_H
+
+#include "Calculator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// What generated code needs at run time besides the variables: trig helpers read the settings through it and
+// report undefined tangents in status
+struct NativeContext
+{
+    const Calculator* calculator;
+    const Calculator::Settings* settings;
+    unsigned char status; // Calculator::EvalStatus
+};
+
+// One expression compiled to machine code in its own executable mapping
+class NativeProgram
+{
+public:
+    // Generated function: evaluates into *result and returns a Calculator::EvalStatus
+    typedef int (*Entry)(const double* variableValues, double* result, NativeContext* context);
+
+    NativeProgram(void* code, size_t size);
+    ~NativeProgram();
+
+    NativeProgram(const NativeProgram&) = delete;
+    NativeProgram& operator=(const NativeProgram&) = delete;
+
+    Calculator::EvalStatus run(const double* variableValues, double& result, NativeContext& context) const
+    {
+        return static_cast<Calculator::EvalStatus>(entry(variableValues, &result, &context));
+    }
+
+private:
+    void* code;
+    size_t size;
+    Entry entry;
+};
+
+// x86-64 backend for compiled expressions. The RPN stack maps onto SSE registers, so arithmetic runs with no
+// memory traffic; pow, min, max and the other functions call back into helpers. Returns null when the platform is not x86-64
+// with mmap, when executable memory cannot be obtained, or when the program needs more stack than there are
+// registers, and callers keep using the interpreter.
+class NativeCompiler
+{
+public:
+    static std::shared_ptr<const NativeProgram> compile(const std::vector<Calculator::Token>& rpnProgram, int maxStackDepth);
+
+private:
+    // Called from generated code; x in xmm0, context in rdi (System V)
+    static double sinHelper(double angle, NativeContext* context);
+    static double cosHelper(double angle, NativeContext* context);
+    static double tanHelper(double angle, NativeContext* context);
+    static double powHelper(double base, double exponent);
+    static double functionHelper(double x, NativeContext* context, int function); // Calculator::OpCode in esi
+    static void extremumHelper(double* values, int count, int maximum);         // Folds values[0..count) into values[0]
+};
+
+#endif
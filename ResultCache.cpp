@@ -0,0 +1,57 @@
+#include "ResultCache.h"
+
+ResultCache::ResultCache(size_t capacity) : capacity(capacity), hits(0), misses(0), evictions(0)
+{
+    index.reserve(capacity);
+}
+
+bool ResultCache::find(const std::string& key, double& result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = index.find(key);
+    if (found == index.end())
+    {
+        misses++;
+        return false;
+    }
+    entries.splice(entries.begin(), entries, found->second); // Move to front, iterators stay valid
+    result = found->second->result;
+    hits++;
+    return true;
+}
+
+void ResultCache::insert(std::string key, double result)
+{
+    if (capacity == 0) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = index.find(key);
+    if (found != index.end())
+    {
+        // Another thread computed the same key meanwhile
+        found->second->result = result;
+        entries.splice(entries.begin(), entries, found->second);
+        return;
+    }
+    if (entries.size() >= capacity)
+    {
+        index.erase(entries.back().key);
+        entries.pop_back();
+        evictions++;
+    }
+    entries.push_front(Entry{std::move(key), result});
+    index.emplace(entries.front().key, entries.begin());
+}
+
+void ResultCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    index.clear();
+    entries.clear();
+}
+
+ResultCacheStats ResultCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ResultCacheStats{hits, misses, evictions, entries.size(), capacity};
+}
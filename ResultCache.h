@@ -0,0 +1,52 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Hit/miss/eviction counters of a ResultCache
+struct ResultCacheStats
+{
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t size;     // Entries currently held
+    size_t capacity; // Maximum entries, 0 when the cache is disabled
+};
+
+// Bounded least-recently-used map from an opaque key to an evaluation result. Safe to share between threads.
+class ResultCache
+{
+public:
+    explicit ResultCache(size_t capacity);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    bool find(const std::string& key, double& result); // Marks the entry most recently used; counts a hit or a miss
+    void insert(std::string key, double result);        // Evicts the least recently used entry when full
+    void clear();                                       // Drops every entry, counters are kept
+
+    ResultCacheStats getStats() const;
+
+private:
+    struct Entry
+    {
+        std::string key;
+        double result;
+    };
+
+    const size_t capacity;
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index; // Views into entries' keys
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    mutable std::mutex mutex;
+};
+
+#endif
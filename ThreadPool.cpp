@@ -0,0 +1,167 @@
+#include "ThreadPool.h"
+
+#include <chrono>
+
+struct ThreadPool::Loop
+{
+    const std::function<void(size_t, size_t)>* body;
+    std::atomic<size_t> remaining; // Chunks not finished yet
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+// Index of the queue the current thread pushes to and pops from first; threads outside any pool use the shared last one
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentQueue = 0;
+
+ThreadPool::ThreadPool(unsigned threads) : queued(0), stopping(false)
+{
+    if (threads == 0)
+    {
+        const unsigned hardware = std::thread::hardware_concurrency();
+        threads = (hardware > 1) ? hardware - 1 : 0;
+    }
+    for (unsigned index = 0; index <= threads; index++) queues.push_back(std::make_unique<Queue>());
+    for (unsigned index = 0; index < threads; index++) workers.emplace_back(&ThreadPool::run, this, size_t(index));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+/*------------
+Scheduling
+-------------*/
+void ThreadPool::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body, unsigned maxThreads)
+{
+    if (count == 0) return;
+    if (grainSize == 0) grainSize = 1;
+    const size_t chunks = (count + grainSize - 1) / grainSize;
+    if (chunks == 1 || workers.empty() || maxThreads == 1)
+    {
+        body(0, count);
+        return;
+    }
+    if (maxThreads != 0 && maxThreads < chunks && maxThreads < getConcurrency())
+    {
+        // Capped: maxThreads lane tasks, each taking chunks from a shared counter until none are left. A lane runs
+        // on one thread, so no more than maxThreads run body, and lanes that finish early take over the remaining
+        // chunks as stealing would.
+        std::atomic<size_t> nextChunk(0);
+        const std::function<void(size_t, size_t)> lane = [&](size_t, size_t)
+        {
+            for (size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed); chunk < chunks; chunk = nextChunk.fetch_add(1, std::memory_order_relaxed))
+            {
+                const size_t begin = chunk * grainSize;
+                body(begin, (begin + grainSize < count) ? begin + grainSize : count);
+            }
+        };
+        parallelFor(maxThreads, 1, lane);
+        return;
+    }
+
+    Loop loop;
+    loop.body = &body;
+    loop.remaining.store(chunks, std::memory_order_relaxed);
+
+    // Deal contiguous runs of chunks to every queue so each worker starts on its own part of the range
+    const size_t home = (currentPool == this) ? currentQueue : queues.size() - 1;
+    const size_t queueCount = queues.size();
+    queued.fetch_add(chunks, std::memory_order_release); // Before the pushes, so a pop never runs the count below zero
+    for (size_t offset = 0; offset < queueCount; offset++)
+    {
+        const size_t queue = (home + offset) % queueCount;
+        const size_t first = chunks * offset / queueCount;
+        const size_t last = chunks * (offset + 1) / queueCount;
+        if (first == last) continue;
+        std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+        for (size_t chunk = first; chunk < last; chunk++)
+        {
+            const size_t begin = chunk * grainSize;
+            const size_t end = (begin + grainSize < count) ? begin + grainSize : count;
+            queues[queue]->tasks.push_back(Task{&loop, begin, end});
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex); // Orders the count before any sleeping worker's re-check
+    }
+    wake.notify_all();
+
+    // Help until every chunk of this loop is done; tasks of other loops are fine to run meanwhile
+    Task task;
+    while (loop.remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (popOwn(home, task) || steal(home, task))
+        {
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(loop.mutex);
+        loop.finished.wait_for(lock, std::chrono::milliseconds(1), [&] { return loop.remaining.load(std::memory_order_acquire) == 0; });
+    }
+    std::lock_guard<std::mutex> lock(loop.mutex); // The last executor may still be notifying; loop lives on this stack
+}
+
+bool ThreadPool::popOwn(size_t queue, Task& task)
+{
+    Queue& own = *queues[queue];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.tasks.empty()) return false;
+    task = own.tasks.back();
+    own.tasks.pop_back();
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::steal(size_t thief, Task& task)
+{
+    for (size_t offset = 1; offset < queues.size(); offset++)
+    {
+        Queue& victim = *queues[(thief + offset) % queues.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock); // Busy victim: try the next one
+        if (!lock.owns_lock() || victim.tasks.empty()) continue;
+        task = victim.tasks.front();
+        victim.tasks.pop_front();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(const Task& task)
+{
+    Loop& loop = *task.loop;
+    (*loop.body)(task.begin, task.end);
+    std::lock_guard<std::mutex> lock(loop.mutex);
+    if (loop.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) loop.finished.notify_all();
+}
+
+void ThreadPool::run(size_t worker)
+{
+    currentPool = this;
+    currentQueue = worker;
+    Task task;
+    while (true)
+    {
+        if (popOwn(worker, task) || steal(worker, task))
+        {
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping) return;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for data parallel loops. Each worker owns a deque of range tasks: it takes work from the back of
+// its own deque and, once that is empty, steals from the front of the others', so uneven chunks even out without a
+// shared queue every thread contends on.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = 0); // 0 uses one worker per hardware thread, less the caller
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& shared(); // Process-wide pool, started on first use
+
+    unsigned getConcurrency() const { return unsigned(workers.size()) + 1; } // Workers plus the calling thread
+
+    // Runs body(begin, end) over [0, count) in chunks of at most grainSize. The calling thread works on the chunks
+    // too and returns once all of them are done. body must not throw; it may call parallelFor itself.
+    // maxThreads > 0 caps how many threads run body at once, the caller included; 0 lets every thread in.
+    void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body, unsigned maxThreads = 0);
+
+private:
+    struct Loop; // One parallelFor call in flight
+
+    struct Task
+    {
+        Loop* loop;
+        size_t begin;
+        size_t end;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool popOwn(size_t queue, Task& task);
+    bool steal(size_t thief, Task& task);
+    void execute(const Task& task);
+    void run(size_t worker);
+
+    std::vector<std::unique_ptr<Queue>> queues; // One per worker, the last one for threads outside the pool
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued; // Tasks sitting in any queue
+
+    std::mutex sleepMutex;
+    std::condition_variable wake; // Idle workers wait here for new tasks
+    bool stopping;
+};
+
+#endif
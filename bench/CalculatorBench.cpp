@@ -0,0 +1,1096 @@
+// Microbenchmark and throughput suite for every pipeline stage, the trig series, the math kernels and the TVM solvers.
+//
+//   calculator_bench [--filter text] [--min-time seconds] [--json]
+//   calculator_bench --accuracy
+//   calculator_bench --stress [--threads n] [--min-time seconds]
+//
+// Each benchmark is timed for at least --min-time (default 0.25s) and reports ns/op, heap allocations/op and
+// throughput. --json prints one object per benchmark so two runs can be diffed. --accuracy instead prints the
+// error of each math kernel in units in the last place, against long double libm. --stress instead runs n threads
+// (default one per core, at least 2) on one Calculator while its settings keep changing for --min-time (default 2s),
+// reports their throughput and exits with 1 if any result mixed two settings snapshots.
+#include "AmortizationSchedule.h"
+#include "Calculator.h"
+#include "MathKernels.h"
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*------------------
+Allocation Counting
+-------------------*/
+static std::atomic<size_t> allocationCount(0);
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+// The replaced operator new allocates with malloc, so free is the matching release. GCC does not look through the
+// replacement: once these are inlined it sees operator new memory reach free and warns, wrongly, at every delete.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+/*------------
+Harness
+-------------*/
+// Keeps a result alive so the optimizer cannot drop the work that produced it
+static volatile double sink;
+
+struct Benchmark
+{
+    std::string name;
+    size_t itemsPerOp;                       // Rows or records one op processes, for items/s
+    size_t bytesPerOp;                       // Input text one op consumes, for MB/s (0 when not parsing)
+    std::function<void(size_t iterations)> run;
+};
+
+struct BenchResult
+{
+    std::string name;
+    size_t iterations;
+    double nsPerOp;
+    double allocationsPerOp;
+    double itemsPerSecond;
+    double bytesPerSecond;
+};
+
+static BenchResult measure(const Benchmark& benchmark, double minSeconds)
+{
+    typedef std::chrono::steady_clock Clock;
+    benchmark.run(1); // Warm caches and scratch buffers
+
+    size_t iterations = 1;
+    while (true)
+    {
+        const size_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+        const Clock::time_point start = Clock::now();
+        benchmark.run(iterations);
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const size_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+        if (seconds >= minSeconds)
+        {
+            BenchResult result;
+            result.name = benchmark.name;
+            result.iterations = iterations;
+            result.nsPerOp = seconds * 1e9 / iterations;
+            result.allocationsPerOp = static_cast<double>(allocations) / iterations;
+            result.itemsPerSecond = iterations * benchmark.itemsPerOp / seconds;
+            result.bytesPerSecond = iterations * benchmark.bytesPerOp / seconds;
+            return result;
+        }
+        // Aim a little past the target so the next round is usually the last
+        const double scale = (seconds > 0) ? minSeconds * 1.2 / seconds : 100;
+        iterations = static_cast<size_t>(iterations * ((scale > 100) ? 100 : (scale < 2) ? 2 : scale));
+    }
+}
+
+/*------------
+Corpus
+-------------*/
+static const std::vector<std::string> variableNames = {"x", "y"};
+
+static std::string nestedExpression(int depth)
+{
+    std::string expression;
+    for (int level = 0; level < depth; level++) expression += "(";
+    expression += "1";
+    for (int level = 0; level < depth; level++) expression += (level % 2 == 0) ? "+2)*1.5" : "-3)/2";
+    return expression;
+}
+
+static std::string longExpression(int terms, bool variables)
+{
+    const char* operators = "+-*/";
+    std::string expression = "1.25";
+    for (int term = 0; term < terms; term++)
+    {
+        expression += operators[term % 4];
+        expression += (variables && term % 3 == 0) ? ((term % 2 == 0) ? "x" : "y") : std::to_string(term % 9 + 1) + ".5";
+    }
+    return expression;
+}
+
+struct CorpusEntry
+{
+    const char* label;
+    std::string expression;
+    bool radianMode;
+};
+
+static std::vector<CorpusEntry> expressionCorpus()
+{
+    return {
+        {"short", "3+4*2/(1-5)^2", false},
+        {"nested", nestedExpression(32), false},
+        {"long", longExpression(200, false), false},
+        {"variables", longExpression(200, true), false},
+        {"huge", longExpression(2500, false), false}, // About 10 KB
+        {"trig_degrees", "sin(30)*cos(45)+tan(60)-sin(x)*cos(y)", false},
+        {"trig_radians", "sin(pi/6)*cos(x)+tan(y/4)-sin(2*pi*x)", true},
+        {"tvm_formula", "x*(0.05/12)/(1-(1+0.05/12)^(-360))+y*(1+0.05/12)^(12*30)", false},
+        {"functions", "exp(-x*0.05)*sqrt(y)+ln(1+x)-max(x,y,1)+atan(y)", true},
+    };
+}
+
+// TVM parameter sweep: rates from 0.1% to 2% per period, 12 to 355 periods. Payments cover 25% to 95% of the
+// interest, so each cash flow changes sign once and the rate has a single root.
+struct TvmCase
+{
+    double pv, fv, pmt, i, n;
+};
+
+static std::vector<TvmCase> tvmSweep()
+{
+    std::vector<TvmCase> cases;
+    for (int rate = 0; rate < 8; rate++)
+    {
+        for (int periods = 0; periods < 8; periods++)
+        {
+            TvmCase tvm;
+            tvm.i = 0.001 + rate * 0.0027;
+            tvm.n = 12 + periods * 49;
+            tvm.pv = 10000 + rate * 2500;
+            tvm.pmt = -tvm.pv * tvm.i * (0.25 + periods * 0.1);
+            tvm.fv = -(tvm.pv * std::pow(1 + tvm.i, tvm.n) + tvm.pmt * (std::pow(1 + tvm.i, tvm.n) - 1) / tvm.i);
+            cases.push_back(tvm);
+        }
+    }
+    return cases;
+}
+
+/*--------------------
+String Token Pipeline
+---------------------*/
+// The pipeline as it was before tokens became an opcode stream: every token holds a std::string, operators are told
+// apart by string compares and each literal is re-parsed with std::stod every time the RPN runs. Kept only as the
+// "before" side of the tokens/ benchmarks, so it covers arithmetic and nothing else.
+struct StringToken
+{
+    enum Type { NUMBER, OPERATOR, LEFT_PAREN, RIGHT_PAREN };
+    Type type;
+    std::string value;
+};
+
+static std::vector<StringToken> stringTokenize(const std::string& expression)
+{
+    std::vector<StringToken> tokens;
+    std::string currentToken;
+    bool expectNumber = true;
+    for (size_t index = 0; index < expression.length(); index++)
+    {
+        currentToken.clear();
+        const char character = expression[index];
+        if (std::isspace(static_cast<unsigned char>(character))) continue;
+        if (std::isdigit(static_cast<unsigned char>(character)) || character == '.')
+        {
+            while (index < expression.length() && (std::isdigit(static_cast<unsigned char>(expression[index])) || expression[index] == '.'))
+            {
+                currentToken += expression[index++];
+            }
+            index--;
+            tokens.push_back(StringToken{StringToken::NUMBER, currentToken});
+            expectNumber = false;
+        }
+        else if (character == '-' && expectNumber)
+        {
+            tokens.push_back(StringToken{StringToken::OPERATOR, "u-"});
+        }
+        else if (std::strchr("^*/+-", character))
+        {
+            tokens.push_back(StringToken{StringToken::OPERATOR, std::string(1, character)});
+            expectNumber = true;
+        }
+        else if (character == '(')
+        {
+            tokens.push_back(StringToken{StringToken::LEFT_PAREN, "("});
+            expectNumber = true;
+        }
+        else if (character == ')')
+        {
+            tokens.push_back(StringToken{StringToken::RIGHT_PAREN, ")"});
+            expectNumber = false;
+        }
+        else
+        {
+            throw std::invalid_argument(std::string("Unrecognized character: ") + character);
+        }
+    }
+    return tokens;
+}
+
+static int stringPrecedence(const std::string& operation)
+{
+    if (operation == "+" || operation == "-") return 1;
+    if (operation == "*" || operation == "/") return 2;
+    if (operation == "^") return 3;
+    if (operation == "u-") return 4;
+    return 0;
+}
+
+static std::vector<StringToken> stringConvertToRPN(const std::vector<StringToken>& tokens)
+{
+    std::vector<StringToken> outputStack, operatorStack;
+    for (const StringToken& token : tokens)
+    {
+        if (token.type == StringToken::NUMBER)
+        {
+            outputStack.push_back(token);
+        }
+        else if (token.type == StringToken::OPERATOR)
+        {
+            const bool leftAssociative = (token.value != "^" && token.value != "u-");
+            while (!operatorStack.empty() && operatorStack.back().type != StringToken::LEFT_PAREN &&
+                   (stringPrecedence(operatorStack.back().value) > stringPrecedence(token.value) ||
+                   (stringPrecedence(operatorStack.back().value) == stringPrecedence(token.value) && leftAssociative)))
+            {
+                outputStack.push_back(operatorStack.back());
+                operatorStack.pop_back();
+            }
+            operatorStack.push_back(token);
+        }
+        else if (token.type == StringToken::LEFT_PAREN)
+        {
+            operatorStack.push_back(token);
+        }
+        else
+        {
+            while (!operatorStack.empty() && operatorStack.back().type != StringToken::LEFT_PAREN)
+            {
+                outputStack.push_back(operatorStack.back());
+                operatorStack.pop_back();
+            }
+            if (operatorStack.empty()) throw std::invalid_argument("Mismatched parenthesis, missing: '('");
+            operatorStack.pop_back();
+        }
+    }
+    while (!operatorStack.empty())
+    {
+        if (operatorStack.back().type == StringToken::LEFT_PAREN) throw std::invalid_argument("Mismatched parenthesis, missing: ')'");
+        outputStack.push_back(operatorStack.back());
+        operatorStack.pop_back();
+    }
+    return outputStack;
+}
+
+static double stringEvaluateRPN(const std::vector<StringToken>& rpnExpression)
+{
+    std::vector<double> evalStack;
+    for (const StringToken& token : rpnExpression)
+    {
+        if (token.type == StringToken::NUMBER)
+        {
+            evalStack.push_back(std::stod(token.value));
+        }
+        else if (token.value == "u-")
+        {
+            if (evalStack.empty()) throw std::invalid_argument("Invalid expression: not enough operands");
+            evalStack.back() = -evalStack.back();
+        }
+        else
+        {
+            if (evalStack.size() < 2) throw std::invalid_argument("Invalid expression: not enough operands");
+            const double num2 = evalStack.back();
+            evalStack.pop_back();
+            const double num1 = evalStack.back();
+            evalStack.pop_back();
+            if (token.value == "+") evalStack.push_back(num1 + num2);
+            else if (token.value == "-") evalStack.push_back(num1 - num2);
+            else if (token.value == "*") evalStack.push_back(num1 * num2);
+            else if (token.value == "/")
+            {
+                if (num2 == 0) throw std::runtime_error("Division by zero");
+                evalStack.push_back(num1 / num2);
+            }
+            else if (token.value == "^") evalStack.push_back(std::pow(num1, num2));
+        }
+    }
+    if (evalStack.size() != 1) throw std::invalid_argument("Invalid expression: too many operands");
+    return evalStack.back();
+}
+
+// String tokens against the opcode stream on the same arithmetic, end to end (evaluateExpression) and for running an
+// already parsed program (evaluate on a compiled expression)
+static void addTokenStreamBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    const CorpusEntry corpus[] = {
+        {"arithmetic", "1+2*3-4/5", false},
+        {"compound", "(1+0.05/12)^(12*30)*1000", false},
+        {"nested", "((((1+2)*3)-4)/5)^2", false},
+        {"short", "3+4*2/(1-5)^2", false},
+    };
+    for (const CorpusEntry& entry : corpus)
+    {
+        std::shared_ptr<Calculator> calculator = std::make_shared<Calculator>();
+        const std::string expression = entry.expression;
+        const std::string label = entry.label;
+        const size_t bytes = expression.size();
+
+        benchmarks.push_back({"tokens/string/evaluateExpression/" + label, 1, bytes, [=](size_t iterations)
+        {
+            double total = 0;
+            for (size_t iteration = 0; iteration < iterations; iteration++) total += stringEvaluateRPN(stringConvertToRPN(stringTokenize(expression)));
+            sink = total;
+        }});
+        benchmarks.push_back({"tokens/opcode/evaluateExpression/" + label, 1, bytes, [=](size_t iterations)
+        {
+            double total = 0;
+            for (size_t iteration = 0; iteration < iterations; iteration++) total += calculator->evaluateExpression(expression);
+            sink = total;
+        }});
+
+        std::shared_ptr<std::vector<StringToken>> rpn = std::make_shared<std::vector<StringToken>>(stringConvertToRPN(stringTokenize(expression)));
+        benchmarks.push_back({"tokens/string/evaluateRPN/" + label, 1, 0, [=](size_t iterations)
+        {
+            double total = 0;
+            for (size_t iteration = 0; iteration < iterations; iteration++) total += stringEvaluateRPN(*rpn);
+            sink = total;
+        }});
+        std::shared_ptr<Calculator::CompiledExpression> compiled = std::make_shared<Calculator::CompiledExpression>(calculator->compile(expression));
+        benchmarks.push_back({"tokens/opcode/evaluate/" + label, 1, 0, [=](size_t iterations)
+        {
+            double total = 0;
+            for (size_t iteration = 0; iteration < iterations; iteration++) total += calculator->evaluate(*compiled);
+            sink = total;
+        }});
+    }
+}
+
+/*-----------------------
+Compile-Time Expressions
+------------------------*/
+// Calculator::constEval results are computed while this file compiles: each static_assert only holds if the
+// expression was parsed and evaluated then
+static_assert(Calculator::constEval("2^10") == 1024, "powers of two are exact");
+static_assert(Calculator::constEval("3+4*2/(1-5)^2") == 3.5, "precedence and associativity");
+static_assert(Calculator::constEval("-2^2") == 4, "unary minus binds tighter than ^");
+static_assert(Calculator::constEval("sqrt(16)+abs(-3)+min(4,2,8)+max(1,7)") == 16, "exact functions");
+static_assert(Calculator::constEval("0.1+0.2") == 0.1 + 0.2, "literals round as the compiler rounds them");
+static_assert(Calculator::constEval("sin(180)-cos(90)", Calculator::Settings{false, false, 10, .05, 10, 1e-10}) == 0, "degree mode snaps to zero");
+constexpr double growth = Calculator::constEval("2*pi*(1+0.05)^10");
+static_assert(growth > 10.2346 && growth < 10.2347, "2 pi 1.05^10");
+
+// The corpus expressions with variables, parsed at compile time for Calculator::evaluate<Program>
+static constexpr const char* constVariableNames[] = {"x", "y"};
+static constexpr ConstExpression::Program shortProgram = ConstExpression::compile("3+4*2/(1-5)^2", constVariableNames);
+static constexpr ConstExpression::Program trigDegreesProgram = ConstExpression::compile("sin(30)*cos(45)+tan(60)-sin(x)*cos(y)", constVariableNames);
+static constexpr ConstExpression::Program trigRadiansProgram = ConstExpression::compile("sin(pi/6)*cos(x)+tan(y/4)-sin(2*pi*x)", constVariableNames);
+static constexpr ConstExpression::Program tvmFormulaProgram = ConstExpression::compile("x*(0.05/12)/(1-(1+0.05/12)^(-360))+y*(1+0.05/12)^(12*30)", constVariableNames);
+static constexpr ConstExpression::Program functionsProgram = ConstExpression::compile("exp(-x*0.05)*sqrt(y)+ln(1+x)-max(x,y,1)+atan(y)", constVariableNames);
+
+// Same labels and settings as compiled/evaluate/<label> in the stage benchmarks
+template <const ConstExpression::Program& Program>
+static void addConstExpressionBenchmark(std::vector<Benchmark>& benchmarks, const char* label, bool radianMode)
+{
+    std::shared_ptr<Calculator> calculator = std::make_shared<Calculator>();
+    calculator->setRadianMode(radianMode);
+    benchmarks.push_back({std::string("constexpr/evaluate/") + label, 1, 0, [=](size_t iterations)
+    {
+        const double values[2] = {0.75, 1.5};
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++) total += calculator->evaluate<Program>(values);
+        sink = total;
+    }});
+}
+
+static void addConstExpressionBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    addConstExpressionBenchmark<shortProgram>(benchmarks, "short", false);
+    addConstExpressionBenchmark<trigDegreesProgram>(benchmarks, "trig_degrees", false);
+    addConstExpressionBenchmark<trigRadiansProgram>(benchmarks, "trig_radians", true);
+    addConstExpressionBenchmark<tvmFormulaProgram>(benchmarks, "tvm_formula", false);
+    addConstExpressionBenchmark<functionsProgram>(benchmarks, "functions", true);
+}
+
+/*------------------
+Benchmark Registry
+-------------------*/
+// Friend of Calculator: reaches the private pipeline stages so each is timed on its own
+struct CalculatorBenchAccess
+{
+    static void addStageBenchmarks(std::vector<Benchmark>& benchmarks)
+    {
+        const double values[2] = {0.75, 1.5};
+        for (const CorpusEntry& entry : expressionCorpus())
+        {
+            std::shared_ptr<Calculator> calculator = std::make_shared<Calculator>();
+            calculator->setRadianMode(entry.radianMode);
+            const std::string expression = entry.expression;
+            const std::string label = entry.label;
+            const size_t bytes = expression.size();
+
+            // Shared buffers, reused across iterations the way the evaluator's per-thread scratch is
+            struct Stage
+            {
+                std::vector<Calculator::Token> tokens, outputStack, operatorStack;
+                std::vector<double> evalStack;
+            };
+            std::shared_ptr<Stage> stage = std::make_shared<Stage>();
+            calculator->tokenize(expression, variableNames, stage->tokens);
+            calculator->convertToRPN(stage->tokens, stage->outputStack, stage->operatorStack);
+            int maxDepth = 0, variableCount = 0;
+            calculator->validateRPN(stage->outputStack, maxDepth, variableCount);
+            stage->evalStack.resize(maxDepth);
+
+            benchmarks.push_back({"stage/tokenize/" + label, 1, bytes, [=](size_t iterations)
+            {
+                for (size_t iteration = 0; iteration < iterations; iteration++)
+                {
+                    calculator->tokenize(expression, variableNames, stage->tokens);
+                }
+                sink = static_cast<double>(stage->tokens.size());
+            }});
+            benchmarks.push_back({"stage/convertToRPN/" + label, 1, 0, [=](size_t iterations)
+            {
+                std::vector<Calculator::Token> outputStack, operatorStack;
+                for (size_t iteration = 0; iteration < iterations; iteration++)
+                {
+                    calculator->convertToRPN(stage->tokens, outputStack, operatorStack);
+                }
+                sink = static_cast<double>(outputStack.size());
+            }});
+            benchmarks.push_back({"stage/parseToRPN/" + label, 1, bytes, [=](size_t iterations)
+            {
+                std::vector<Calculator::Token> program;
+                Calculator::EvalOutcome error;
+                int depth = 0;
+                for (size_t iteration = 0; iteration < iterations; iteration++)
+                {
+                    calculator->parseToRPN(expression, variableNames, program, depth, error);
+                }
+                sink = static_cast<double>(program.size());
+            }});
+            benchmarks.push_back({"stage/evaluateRPN/" + label, 1, 0, [=](size_t iterations)
+            {
+                const Calculator::Settings settings = calculator->getSettings();
+                double result = 0, total = 0;
+                for (size_t iteration = 0; iteration < iterations; iteration++)
+                {
+                    calculator->evaluateRPN(stage->outputStack, values, stage->evalStack.data(), settings, result);
+                    total += result;
+                }
+                sink = total;
+            }});
+            benchmarks.push_back({"end_to_end/evaluateExpression/" + label, 1, bytes, [=](size_t iterations)
+            {
+                const std::vector<double> valueVector(values, values + 2);
+                double total = 0;
+                for (size_t iteration = 0; iteration < iterations; iteration++)
+                {
+                    total += calculator->evaluateExpression(expression, variableNames, valueVector);
+                }
+                sink = total;
+            }});
+
+            std::shared_ptr<Calculator::CompiledExpression> compiled = std::make_shared<Calculator::CompiledExpression>(calculator->compile(expression, variableNames));
+            benchmarks.push_back({"compiled/evaluate/" + label, 1, 0, [=](size_t iterations)
+            {
+                double total = 0;
+                for (size_t iteration = 0; iteration < iterations; iteration++) total += calculator->evaluate(*compiled, values);
+                sink = total;
+            }});
+            std::shared_ptr<Calculator::CompiledExpression> native = std::make_shared<Calculator::CompiledExpression>(calculator->compileNative(expression, variableNames));
+            if (native->isNative())
+            {
+                benchmarks.push_back({"compiled/native/" + label, 1, 0, [=](size_t iterations)
+                {
+                    double total = 0;
+                    for (size_t iteration = 0; iteration < iterations; iteration++) total += calculator->evaluate(*native, values);
+                    sink = total;
+                }});
+            }
+
+            const size_t rows = 1024;
+            std::shared_ptr<std::vector<double>> columns = std::make_shared<std::vector<double>>(rows * 3);
+            for (size_t row = 0; row < rows; row++)
+            {
+                (*columns)[row] = 0.5 + row * 0.001;
+                (*columns)[rows + row] = 1.5 - row * 0.0005;
+            }
+            benchmarks.push_back({"batch/evaluateBatch/" + label, rows, 0, [=](size_t iterations)
+            {
+                const double* const variableColumns[2] = {columns->data(), columns->data() + rows};
+                double* results = columns->data() + 2 * rows;
+                for (size_t iteration = 0; iteration < iterations; iteration++)
+                {
+                    calculator->evaluateBatch(*compiled, variableColumns, rows, results);
+                }
+                sink = results[rows - 1];
+            }});
+        }
+    }
+
+    static void addTrigBenchmarks(std::vector<Benchmark>& benchmarks)
+    {
+        // Small angles skip reduction; large ones exercise it
+        const double magnitudes[] = {0.5, 90, 1e4, 1e8};
+        const char* labels[] = {"0.5", "90", "1e4", "1e8"};
+        for (int radianMode = 0; radianMode < 2; radianMode++)
+        {
+            std::shared_ptr<Calculator> calculator = std::make_shared<Calculator>();
+            calculator->setRadianMode(radianMode != 0);
+            const std::string mode = radianMode ? "radians/" : "degrees/";
+            for (int index = 0; index < 4; index++)
+            {
+                const double angle = magnitudes[index] + 0.123;
+                const std::string suffix = mode + labels[index];
+                benchmarks.push_back({"trig/calcSin/" + suffix, 1, 0, [=](size_t iterations)
+                {
+                    const Calculator::Settings settings = calculator->getSettings();
+                    double total = 0, step = 0;
+                    for (size_t iteration = 0; iteration < iterations; iteration++, step += 1e-7) total += calculator->calcSin(angle + step, settings);
+                    sink = total;
+                }});
+                benchmarks.push_back({"trig/calcCos/" + suffix, 1, 0, [=](size_t iterations)
+                {
+                    const Calculator::Settings settings = calculator->getSettings();
+                    double total = 0, step = 0;
+                    for (size_t iteration = 0; iteration < iterations; iteration++, step += 1e-7) total += calculator->calcCos(angle + step, settings);
+                    sink = total;
+                }});
+                benchmarks.push_back({"trig/calcTan/" + suffix, 1, 0, [=](size_t iterations)
+                {
+                    const Calculator::Settings settings = calculator->getSettings();
+                    double total = 0, step = 0;
+                    for (size_t iteration = 0; iteration < iterations; iteration++, step += 1e-7) total += calculator->calcTan(angle + step, settings);
+                    sink = total;
+                }});
+            }
+        }
+    }
+};
+
+// evaluateAll over a mixed batch on 1, 2, ... up to one thread per core, to show how it scales. Items are the
+// corpus expressions without variables, plus a division by zero and a parse error so failing items are paid for too.
+static void addParallelBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    const std::string items[] = {"3+4*2/(1-5)^2", nestedExpression(32), longExpression(200, false), "sin(30)*cos(45)+tan(60)",
+                                 "(1+0.05/12)^(12*30)*1000", "exp(-0.05)*sqrt(2)+ln(3)-max(1,2,3)", "1/(2-2)", "3+*4"};
+    const size_t count = 4096;
+    std::shared_ptr<std::vector<std::string>> expressions = std::make_shared<std::vector<std::string>>();
+    size_t bytes = 0;
+    for (size_t index = 0; index < count; index++)
+    {
+        expressions->push_back(items[index % (sizeof(items) / sizeof(items[0]))]);
+        bytes += expressions->back().size();
+    }
+
+    std::shared_ptr<Calculator> calculator = std::make_shared<Calculator>();
+    const unsigned hardware = std::thread::hardware_concurrency();
+    for (unsigned threads = 1; threads <= ((hardware > 1) ? hardware : 1); threads++)
+    {
+        benchmarks.push_back({"parallel/evaluateAll/" + std::to_string(threads) + "_threads", count, bytes, [=](size_t iterations)
+        {
+            double total = 0;
+            for (size_t iteration = 0; iteration < iterations; iteration++) total += calculator->evaluateAll(*expressions, threads)[0].value;
+            sink = total;
+        }});
+    }
+}
+
+// Each op solves one case of the sweep, cycling through all of them
+static void addTvmBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    std::shared_ptr<Calculator> calculator = std::make_shared<Calculator>();
+    std::shared_ptr<std::vector<TvmCase>> cases = std::make_shared<std::vector<TvmCase>>(tvmSweep());
+    const size_t count = cases->size();
+
+    benchmarks.push_back({"tvm/calculateFV", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            total += calculator->calculateFV(tvm.pv, tvm.pmt, tvm.i, tvm.n);
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"tvm/calculatePV", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            total += calculator->calculatePV(tvm.fv, tvm.pmt, tvm.i, tvm.n);
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"tvm/calculatePMT", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            total += calculator->calculatePMT(tvm.pv, tvm.fv, tvm.i, tvm.n);
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"tvm/calculateInterest", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            total += calculator->calculateInterest(tvm.pv, tvm.fv, tvm.pmt, tvm.n);
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"tvm/calculateNumberOfPeriods", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            total += calculator->calculateNumberOfPeriods(tvm.pv, tvm.fv, tvm.pmt, tvm.i);
+        }
+        sink = total;
+    }});
+
+    // Struct-of-arrays batch over the whole sweep
+    std::shared_ptr<std::vector<double>> columns = std::make_shared<std::vector<double>>(count * 6);
+    for (size_t row = 0; row < count; row++)
+    {
+        (*columns)[row] = (*cases)[row].pv;
+        (*columns)[count + row] = (*cases)[row].fv;
+        (*columns)[2 * count + row] = (*cases)[row].pmt;
+        (*columns)[3 * count + row] = (*cases)[row].i;
+        (*columns)[4 * count + row] = (*cases)[row].n;
+    }
+    benchmarks.push_back({"tvm/calculateInterestBatch", count, 0, [=](size_t iterations)
+    {
+        const double* column = columns->data();
+        double* out = columns->data() + 5 * count;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            calculator->calculateInterestBatch(column, column + count, column + 2 * count, column + 4 * count, out, count);
+        }
+        sink = out[count - 1];
+    }});
+}
+
+// Risk figures per op, through bumped re-evaluations against one evaluation on Duals: the rate delta and gamma
+// (value, d/di, d2/di2) and the gradient in all four inputs
+static void addSensitivityBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    using RateDual = Dual<1, 2>;
+    using GradientDual = Dual<4, 1>;
+    std::shared_ptr<Calculator> calculator = std::make_shared<Calculator>();
+    std::shared_ptr<std::vector<TvmCase>> cases = std::make_shared<std::vector<TvmCase>>(tvmSweep());
+    const size_t count = cases->size();
+    const double bump = 1e-5;
+
+    benchmarks.push_back({"sensitivity/bumped/calculatePV/rate", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            const double value = calculator->calculatePV(tvm.fv, tvm.pmt, tvm.i, tvm.n);
+            const double up = calculator->calculatePV(tvm.fv, tvm.pmt, tvm.i + bump, tvm.n);
+            const double down = calculator->calculatePV(tvm.fv, tvm.pmt, tvm.i - bump, tvm.n);
+            total += value + (up - down) / (2 * bump) + (up - 2 * value + down) / (bump * bump);
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"sensitivity/dual/calculatePV/rate", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            const RateDual pv = calculator->calculatePV(RateDual(tvm.fv), RateDual(tvm.pmt), RateDual::variable(tvm.i, 0), RateDual(tvm.n));
+            total += pv.value + pv.gradient[0] + pv.hessian[0][0];
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"sensitivity/bumped/calculatePV/gradient", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            const double value = calculator->calculatePV(tvm.fv, tvm.pmt, tvm.i, tvm.n);
+            total += value + (calculator->calculatePV(tvm.fv + bump, tvm.pmt, tvm.i, tvm.n) - value) / bump +
+                     (calculator->calculatePV(tvm.fv, tvm.pmt + bump, tvm.i, tvm.n) - value) / bump +
+                     (calculator->calculatePV(tvm.fv, tvm.pmt, tvm.i + bump, tvm.n) - value) / bump +
+                     (calculator->calculatePV(tvm.fv, tvm.pmt, tvm.i, tvm.n + bump) - value) / bump;
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"sensitivity/dual/calculatePV/gradient", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            const GradientDual pv = calculator->calculatePV(GradientDual::variable(tvm.fv, 0), GradientDual::variable(tvm.pmt, 1),
+                                                            GradientDual::variable(tvm.i, 2), GradientDual::variable(tvm.n, 3));
+            total += pv.value + pv.gradient[0] + pv.gradient[1] + pv.gradient[2] + pv.gradient[3];
+        }
+        sink = total;
+    }});
+
+    // An annuity written as an expression, x = payment and y = rate
+    std::shared_ptr<Calculator::CompiledExpression> annuity = std::make_shared<Calculator::CompiledExpression>(calculator->compile("x*(1-(1+y)^(-360))/y", variableNames));
+    benchmarks.push_back({"sensitivity/bumped/evaluate/rate", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            const double values[2] = {tvm.pmt, tvm.i}, upValues[2] = {tvm.pmt, tvm.i + bump}, downValues[2] = {tvm.pmt, tvm.i - bump};
+            const double value = calculator->evaluate(*annuity, values);
+            const double up = calculator->evaluate(*annuity, upValues);
+            const double down = calculator->evaluate(*annuity, downValues);
+            total += value + (up - down) / (2 * bump) + (up - 2 * value + down) / (bump * bump);
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"sensitivity/dual/evaluate/rate", 1, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const TvmCase& tvm = (*cases)[iteration % count];
+            const RateDual values[2] = {RateDual(tvm.pmt), RateDual::variable(tvm.i, 0)};
+            const RateDual value = calculator->evaluate(*annuity, values);
+            total += value.value + value.gradient[0] + value.hessian[0][0];
+        }
+        sink = total;
+    }});
+}
+
+// Schedules for the sweep's loans, walked lazily row by row and written in bulk to columns
+static void addAmortizationBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    std::shared_ptr<Calculator> calculator = std::make_shared<Calculator>();
+    std::shared_ptr<std::vector<TvmCase>> cases = std::make_shared<std::vector<TvmCase>>(tvmSweep());
+    const size_t count = cases->size();
+
+    std::shared_ptr<std::vector<double>> inputs = std::make_shared<std::vector<double>>(count * 2);
+    std::shared_ptr<std::vector<int>> periods = std::make_shared<std::vector<int>>(count);
+    std::shared_ptr<std::vector<size_t>> offsets = std::make_shared<std::vector<size_t>>(count + 1);
+    for (size_t loan = 0; loan < count; loan++)
+    {
+        (*inputs)[loan] = (*cases)[loan].pv;
+        (*inputs)[count + loan] = (*cases)[loan].i;
+        (*periods)[loan] = static_cast<int>((*cases)[loan].n);
+    }
+    const size_t rows = AmortizationSchedule::rowOffsets(periods->data(), count, offsets->data());
+    std::shared_ptr<std::vector<double>> columns = std::make_shared<std::vector<double>>(rows * 4);
+
+    benchmarks.push_back({"amortization/lazy", rows, 0, [=](size_t iterations)
+    {
+        double total = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            for (size_t loan = 0; loan < count; loan++)
+            {
+                for (const AmortizationRow& row : AmortizationSchedule(*calculator, (*inputs)[loan], (*inputs)[count + loan], (*periods)[loan]))
+                {
+                    total += row.balance;
+                }
+            }
+        }
+        sink = total;
+    }});
+    benchmarks.push_back({"amortization/bulk", rows, 0, [=](size_t iterations)
+    {
+        double* column = columns->data();
+        const AmortizationSchedule::Columns out = {column, column + rows, column + 2 * rows, column + 3 * rows};
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            AmortizationSchedule::generate(*calculator, inputs->data(), inputs->data() + count, periods->data(), nullptr, count, offsets->data(), out);
+        }
+        sink = column[4 * rows - 1];
+    }});
+}
+
+/*------------
+Math Kernels
+-------------*/
+struct MathFunction
+{
+    const char* name;
+    double (*kernel)(double);
+    void (*block)(const double*, double*, size_t);
+    double (*libm)(double);
+    long double (*reference)(long double);
+    double low, high; // Input range benchmarked and sampled for accuracy
+};
+
+static const MathFunction mathFunctions[] = {
+    {"exp", MathKernels::exp, MathKernels::expBlock, std::exp, std::exp, -700, 700},
+    {"ln", MathKernels::ln, MathKernels::lnBlock, std::log, std::log, 1e-300, 1e300},
+    {"log", MathKernels::log10, MathKernels::log10Block, std::log10, std::log10, 1e-300, 1e300},
+    {"asin", MathKernels::asin, MathKernels::asinBlock, std::asin, std::asin, -1, 1},
+    {"acos", MathKernels::acos, MathKernels::acosBlock, std::acos, std::acos, -1, 1},
+    {"atan", MathKernels::atan, MathKernels::atanBlock, std::atan, std::atan, -100, 100},
+    {"sinh", MathKernels::sinh, MathKernels::sinhBlock, std::sinh, std::sinh, -700, 700},
+    {"cosh", MathKernels::cosh, MathKernels::coshBlock, std::cosh, std::cosh, -700, 700},
+    {"tanh", MathKernels::tanh, MathKernels::tanhBlock, std::tanh, std::tanh, -20, 20},
+};
+
+// count inputs spread over [low, high]; geometrically for ln and log, whose ranges span the exponents
+static std::vector<double> mathInputs(const MathFunction& function, size_t count)
+{
+    std::vector<double> inputs(count);
+    const bool geometric = function.low > 0;
+    for (size_t index = 0; index < count; index++)
+    {
+        const double fraction = (index + 0.5) / count;
+        inputs[index] = geometric ? std::exp(std::log(function.low) + (std::log(function.high) - std::log(function.low)) * fraction)
+                                  : function.low + (function.high - function.low) * fraction;
+    }
+    return inputs;
+}
+
+// Each kernel one value at a time, as a block, and libm for comparison
+static void addMathBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    const size_t count = 1024;
+    for (const MathFunction& function : mathFunctions)
+    {
+        std::shared_ptr<std::vector<double>> inputs = std::make_shared<std::vector<double>>(mathInputs(function, count));
+        std::shared_ptr<std::vector<double>> outputs = std::make_shared<std::vector<double>>(count);
+        const std::string prefix = std::string("math/") + function.name;
+        benchmarks.push_back({prefix + "/kernel", count, 0, [=](size_t iterations)
+        {
+            double total = 0;
+            for (size_t iteration = 0; iteration < iterations; iteration++)
+            {
+                for (double input : *inputs) total += function.kernel(input);
+            }
+            sink = total;
+        }});
+        benchmarks.push_back({prefix + "/block", count, 0, [=](size_t iterations)
+        {
+            for (size_t iteration = 0; iteration < iterations; iteration++) function.block(inputs->data(), outputs->data(), count);
+            sink = (*outputs)[count - 1];
+        }});
+        benchmarks.push_back({prefix + "/libm", count, 0, [=](size_t iterations)
+        {
+            double total = 0;
+            for (size_t iteration = 0; iteration < iterations; iteration++)
+            {
+                for (double input : *inputs) total += function.libm(input);
+            }
+            sink = total;
+        }});
+    }
+}
+
+// Maximum and mean error of each kernel over a million inputs, in units in the last place of the exact result
+static void printAccuracy()
+{
+    const size_t count = 1000000;
+    std::printf("%-6s %14s %14s %14s\n", "", "max ulp", "mean ulp", "libm max ulp");
+    for (const MathFunction& function : mathFunctions)
+    {
+        double maxError = 0, sumError = 0, libmMaxError = 0;
+        for (double input : mathInputs(function, count))
+        {
+            const long double exact = function.reference(input);
+            if (!std::isfinite(static_cast<double>(exact)) || exact == 0) continue;
+            int exponent;
+            std::frexp(static_cast<double>(exact), &exponent);
+            const long double ulp = std::ldexp(1.0L, ((exponent - 53 < -1074) ? -1074 : exponent - 53));
+            const double error = static_cast<double>(std::fabs(function.kernel(input) - exact) / ulp);
+            const double libmError = static_cast<double>(std::fabs(function.libm(input) - exact) / ulp);
+            maxError = (error > maxError) ? error : maxError;
+            libmMaxError = (libmError > libmMaxError) ? libmError : libmMaxError;
+            sumError += error;
+        }
+        std::printf("%-6s %14.3f %14.3f %14.3f\n", function.name, maxError, sumError / count, libmMaxError);
+    }
+}
+
+/*-----------------
+Concurrency Stress
+------------------*/
+// threads threads evaluate on one shared Calculator for the given time while another keeps flipping radianMode and
+// switching the result cache on and off. sin(30)+cos(60) differs in degree and radian mode, so an evaluation that
+// read part of one settings snapshot and part of the next gives a value matching neither mode; each evaluateAll call
+// must also use one mode for all of its items. Prints the throughput of each path and returns the number of mixed
+// results.
+static size_t runStress(unsigned threads, double seconds)
+{
+    const std::string expression = "sin(30)+cos(60)";
+    const std::vector<std::string> batch(64, expression);
+    const double angle[1] = {60};
+
+    // Expected results, computed on a private Calculator per mode. The compiled form folds sin(30) under the
+    // settings it was compiled with, so the other mode exercises its unfolded program.
+    Calculator shared(false);
+    const Calculator::CompiledExpression compiled = shared.compile("sin(30)+cos(x)", {"x"});
+    double expectedString[2], expectedCompiled[2];
+    for (int radianMode = 0; radianMode < 2; radianMode++)
+    {
+        Calculator reference(radianMode != 0);
+        expectedString[radianMode] = reference.evaluateExpression(expression);
+        expectedCompiled[radianMode] = reference.evaluate(reference.compile("sin(30)+cos(x)", {"x"}), angle);
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> mixed(0), stringCount(0), compiledCount(0), batchCount(0);
+    std::vector<std::thread> evaluators;
+    for (unsigned thread = 0; thread < threads; thread++)
+    {
+        evaluators.emplace_back([&, thread]
+        {
+            size_t strings = 0, compiledRuns = 0, batches = 0, wrong = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                // Each thread leans on a different path, and every thread touches all three
+                const int path = (thread + strings + compiledRuns + batches) % 3;
+                if (path == 0)
+                {
+                    const double value = shared.tryEvaluate(expression).value;
+                    wrong += (value != expectedString[0] && value != expectedString[1]);
+                    strings++;
+                }
+                else if (path == 1)
+                {
+                    const double value = shared.evaluate(compiled, angle);
+                    wrong += (value != expectedCompiled[0] && value != expectedCompiled[1]);
+                    compiledRuns++;
+                }
+                else
+                {
+                    const std::vector<Calculator::EvalResult> results = shared.evaluateAll(batch);
+                    const double first = results[0].value;
+                    bool consistent = (first == expectedString[0] || first == expectedString[1]);
+                    for (const Calculator::EvalResult& result : results) consistent = consistent && (result.value == first);
+                    wrong += !consistent;
+                    batches++;
+                }
+            }
+            mixed.fetch_add(wrong);
+            stringCount.fetch_add(strings);
+            compiledCount.fetch_add(compiledRuns);
+            batchCount.fetch_add(batches);
+        });
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    size_t toggles = 0;
+    while (std::chrono::duration<double>(Clock::now() - start).count() < seconds)
+    {
+        shared.setRadianMode(toggles % 2 == 0);
+        if (toggles % 16 == 0) shared.enableResultCache((toggles % 32 == 0) ? 256 : 0);
+        toggles++;
+        std::this_thread::yield();
+    }
+    stop.store(true);
+    for (std::thread& evaluator : evaluators) evaluator.join();
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::printf("%u evaluating threads, %zu settings changes in %.2fs\n", threads, toggles, elapsed);
+    std::printf("%-46s %14.0f evaluations/s\n", "stress/tryEvaluate", stringCount.load() / elapsed);
+    std::printf("%-46s %14.0f evaluations/s\n", "stress/evaluate(compiled)", compiledCount.load() / elapsed);
+    std::printf("%-46s %14.0f evaluations/s\n", "stress/evaluateAll", batchCount.load() * batch.size() / elapsed);
+    std::printf("mixed-mode results: %zu\n", mixed.load());
+    return mixed.load();
+}
+
+/*------------
+Reporting
+-------------*/
+static void printText(const BenchResult& result)
+{
+    std::printf("%-46s %12.1f ns/op %8.2f allocs/op %14.0f items/s", result.name.c_str(), result.nsPerOp, result.allocationsPerOp, result.itemsPerSecond);
+    if (result.bytesPerSecond > 0) std::printf(" %9.1f MB/s", result.bytesPerSecond / 1e6);
+    std::printf("\n");
+}
+
+static void printJson(const std::vector<BenchResult>& results)
+{
+    std::printf("[\n");
+    for (size_t index = 0; index < results.size(); index++)
+    {
+        const BenchResult& result = results[index];
+        std::printf("  {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f, \"items_per_second\": %.1f, \"bytes_per_second\": %.1f}%s\n",
+                    result.name.c_str(), result.iterations, result.nsPerOp, result.allocationsPerOp, result.itemsPerSecond, result.bytesPerSecond,
+                    (index + 1 < results.size()) ? "," : "");
+    }
+    std::printf("]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    double minSeconds = 0;
+    bool json = false;
+    bool accuracy = false;
+    bool stress = false;
+    unsigned threads = 0;
+    for (int index = 1; index < argc; index++)
+    {
+        if (std::strcmp(argv[index], "--json") == 0) json = true;
+        else if (std::strcmp(argv[index], "--accuracy") == 0) accuracy = true;
+        else if (std::strcmp(argv[index], "--stress") == 0) stress = true;
+        else if (std::strcmp(argv[index], "--threads") == 0 && index + 1 < argc) threads = static_cast<unsigned>(std::atoi(argv[++index]));
+        else if (std::strcmp(argv[index], "--filter") == 0 && index + 1 < argc) filter = argv[++index];
+        else if (std::strcmp(argv[index], "--min-time") == 0 && index + 1 < argc) minSeconds = std::atof(argv[++index]);
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--filter text] [--min-time seconds] [--json] | --accuracy | --stress [--threads n] [--min-time seconds]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (accuracy)
+    {
+        printAccuracy();
+        return 0;
+    }
+    if (stress)
+    {
+        if (threads == 0) threads = (std::thread::hardware_concurrency() > 2) ? std::thread::hardware_concurrency() : 2;
+        return (runStress(threads, (minSeconds > 0) ? minSeconds : 2) == 0) ? 0 : 1;
+    }
+    if (minSeconds <= 0) minSeconds = 0.25;
+
+    std::vector<Benchmark> benchmarks;
+    CalculatorBenchAccess::addStageBenchmarks(benchmarks);
+    CalculatorBenchAccess::addTrigBenchmarks(benchmarks);
+    addParallelBenchmarks(benchmarks);
+    addTokenStreamBenchmarks(benchmarks);
+    addConstExpressionBenchmarks(benchmarks);
+    addTvmBenchmarks(benchmarks);
+    addSensitivityBenchmarks(benchmarks);
+    addAmortizationBenchmarks(benchmarks);
+    addMathBenchmarks(benchmarks);
+
+    std::vector<BenchResult> results;
+    for (const Benchmark& benchmark : benchmarks)
+    {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) continue;
+        results.push_back(measure(benchmark, minSeconds));
+        if (!json) printText(results.back());
+    }
+    if (json) printJson(results);
+    return 0;
+}
@@ -1,5 +1,9 @@
 #include "Calculator.h"
 
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -48,9 +52,226 @@ double getDouble(const std::string &prompt)
     }
 }
 
-int main()
+/*---------------------
+Non-Interactive Modes
+----------------------*/
+// Collects output and writes it in large blocks, so piping millions of lines never flushes per line
+class OutputBuffer
 {
+public:
+    OutputBuffer() { text.reserve(capacity); }
+    ~OutputBuffer() { flush(); }
+
+    void appendNumber(double value)
+    {
+        char number[32];
+        const int length = std::snprintf(number, sizeof(number), "%.15g", value);
+        text.append(number, length);
+    }
+    void append(const std::string& value) { text += value; }
+    void append(const char* value) { text += value; }
+    void endLine()
+    {
+        text += '\n';
+        if (text.size() >= capacity) flush();
+    }
+    void flush()
+    {
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        text.clear();
+    }
+
+private:
+    static const size_t capacity = 1 << 20;
+    std::string text;
+};
+
+// --eval: one expression per input line, one result or "error: message" per output line
+int runEvalMode(const Calculator& calc)
+{
+    OutputBuffer output;
+    calc.evaluateStream(std::cin, [&](const Calculator::EvalResult& result)
+    {
+        if (result.status == Calculator::EVAL_OK)
+        {
+            output.appendNumber(result.value);
+        }
+        else
+        {
+            output.append("error: ");
+            output.append(result.error);
+        }
+        output.endLine();
+    });
+    return 0;
+}
+
+// --tvm unknowns, in the order of tvmUnknownNames
+enum TvmUnknown
+{
+    TVM_FV,
+    TVM_PV,
+    TVM_PMT,
+    TVM_I,
+    TVM_N,
+    TVM_UNKNOWN_COUNT
+};
+const char* const tvmUnknownNames[TVM_UNKNOWN_COUNT] = {"fv", "pv", "pmt", "i", "n"};
+
+// The records of one --tvm chunk that solve for the same unknown, as the columns its batch solver takes
+struct TvmColumns
+{
+    std::vector<double> a, b, c, d, out;
+
+    void clear()
+    {
+        a.clear();
+        b.clear();
+        c.clear();
+        d.clear();
+    }
+};
+
+// Where a --tvm record of the chunk went: its unknown's columns, or the format errors when unknown is TVM_UNKNOWN_COUNT
+struct TvmRecord
+{
+    TvmUnknown unknown;
+    size_t index;
+};
+
+// Solves every record of one unknown at once; the batch solvers return failed rows as NaN
+void solveTvmColumns(const Calculator& calc, TvmUnknown unknown, TvmColumns& columns)
+{
+    const size_t count = columns.a.size();
+    columns.out.resize(count);
+    const double* a = columns.a.data();
+    const double* b = columns.b.data();
+    const double* c = columns.c.data();
+    const double* d = columns.d.data();
+    double* out = columns.out.data();
+    switch (unknown)
+    {
+        case TVM_FV: calc.calculateFVBatch(a, b, c, d, out, count, 0); break;
+        case TVM_PV: calc.calculatePVBatch(a, b, c, d, out, count, 0); break;
+        case TVM_PMT: calc.calculatePMTBatch(a, b, c, d, out, count, 0); break;
+        case TVM_I: calc.calculateInterestBatch(a, b, c, d, out, count, false); break; // Records are unrelated, no warm start
+        case TVM_N: calc.calculateNumberOfPeriodsBatch(a, b, c, d, out, count); break;
+        default: break;
+    }
+}
+
+// Message calculatePMT, calculateInterest and calculateNumberOfPeriods throw for a record their batch form returned
+// as NaN; null when NaN is the answer itself (fv and pv never fail)
+const char* tvmError(TvmUnknown unknown, double c, double d)
+{
+    switch (unknown)
+    {
+        case TVM_PMT: return (c <= 0 || d <= 0) ? "Interest rate and number of periods must be greater than zero." : nullptr;
+        case TVM_I: return (d <= 0) ? "Number of periods must be greater than zero." : "Interest rate calculation did not converge.";
+        case TVM_N: return (d <= 0) ? "Interest rate must be greater than zero." : "Number of periods calculation did not converge.";
+        default: return nullptr;
+    }
+}
+
+// --tvm: one record per input line, "<unknown> a b c d" with the same inputs, in the same order and with rates in
+// percent, as the TVM menu: fv pv pmt i n | pv fv pmt i n | pmt pv fv i n | i pv fv pmt n | n pv fv pmt i
+// Records are read chunkSize at a time and each unknown's records go through its batch solver, like --eval goes
+// through evaluateStream; malformed records and failed rows are reported in place, with no exceptions.
+int runTvmMode(const Calculator& calc)
+{
+    const size_t chunkSize = 16384;
+    OutputBuffer output;
+    std::string line;
+    std::vector<TvmRecord> records;
+    std::vector<std::string> formatErrors;
+    TvmColumns columns[TVM_UNKNOWN_COUNT];
+    records.reserve(chunkSize);
+
+    bool more = true;
+    while (more)
+    {
+        records.clear();
+        formatErrors.clear();
+        for (TvmColumns& unknownColumns : columns) unknownColumns.clear();
+
+        while (records.size() < chunkSize && (more = static_cast<bool>(std::getline(std::cin, line))))
+        {
+            char name[8] = "";
+            double a, b, c, d;
+            char extra;
+            const int fields = std::sscanf(line.c_str(), "%7s %lf %lf %lf %lf %c", name, &a, &b, &c, &d, &extra);
+            int unknown = 0;
+            while (unknown < TVM_UNKNOWN_COUNT && std::strcmp(name, tvmUnknownNames[unknown]) != 0) unknown++;
+            if (fields != 5 || unknown == TVM_UNKNOWN_COUNT)
+            {
+                records.push_back(TvmRecord{TVM_UNKNOWN_COUNT, formatErrors.size()});
+                formatErrors.push_back((fields != 5) ? std::string("expected '<fv|pv|pmt|i|n> a b c d'") : std::string("unknown TVM variable: ") + name);
+                continue;
+            }
+
+            // Rates are entered in percent
+            if (unknown == TVM_N) d /= 100.0;
+            else if (unknown != TVM_I) c /= 100.0;
+            TvmColumns& target = columns[unknown];
+            records.push_back(TvmRecord{static_cast<TvmUnknown>(unknown), target.a.size()});
+            target.a.push_back(a);
+            target.b.push_back(b);
+            target.c.push_back(c);
+            target.d.push_back(d);
+        }
+
+        for (int unknown = 0; unknown < TVM_UNKNOWN_COUNT; unknown++)
+        {
+            solveTvmColumns(calc, static_cast<TvmUnknown>(unknown), columns[unknown]);
+        }
+
+        // Back in input order
+        for (const TvmRecord& record : records)
+        {
+            if (record.unknown == TVM_UNKNOWN_COUNT)
+            {
+                output.append("error: ");
+                output.append(formatErrors[record.index]);
+                output.endLine();
+                continue;
+            }
+
+            const TvmColumns& solved = columns[record.unknown];
+            const double value = solved.out[record.index];
+            const char* error = std::isnan(value) ? tvmError(record.unknown, solved.c[record.index], solved.d[record.index]) : nullptr;
+            if (error != nullptr)
+            {
+                output.append("error: ");
+                output.append(error);
+            }
+            else
+            {
+                output.appendNumber((record.unknown == TVM_I) ? value * 100 : value);
+            }
+            output.endLine();
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+    {
+        std::ios::sync_with_stdio(false); // Buffered std::cin, no per line synchronization with stdio
+        Calculator calc;
+        const std::string mode = argv[1];
+        if (argc == 2 && mode == "--eval") return runEvalMode(calc);
+        if (argc == 2 && mode == "--tvm") return runTvmMode(calc);
+        std::fprintf(stderr, "usage: %s [--eval | --tvm] < input > output\n"
+                             "  --eval  one expression per line\n"
+                             "  --tvm   one '<fv|pv|pmt|i|n> a b c d' record per line, rates in percent\n"
+                             "  with no option the interactive menu starts\n", argv[0]);
+        return (mode == "--help") ? 0 : 2;
+    }
+
     Calculator calc;
+    calc.enableResultCache(1024); // Interactive sessions repeat expressions often
     int menuOption = 0;
     std::string inputExpression = "";
 
@@ -64,8 +285,8 @@ int main()
 
         menuOption = getInteger("Select an option: ");
 
-        double result;
-        double *ptrResult = &result; // Pointer for prev answer recall
+        double result = 0; // Previous answer, bound to the 'ans' variable
+        const std::vector<std::string> recallNames = {"ans"};
 
         try
         {
@@ -79,18 +300,9 @@ int main()
                         inputExpression.clear();
                         std::getline(std::cin, inputExpression);
                         if (inputExpression == "back") break;
-                        if (inputExpression.find("ans") != std::string::npos)
-                        {
-                            std::string prevResult = std::to_string(*ptrResult);
-                            int position = 0;
-                            while ((position = inputExpression.find("ans", position)) != std::string::npos)
-                            {
-                                inputExpression.replace(position, 3, prevResult);
-                            }
-                        }
                         try 
                         {
-                            result = calc.evaluateExpression(inputExpression);
+                            result = calc.evaluateExpression(inputExpression, recallNames, {result});
                             std::cout << "Result: " << result << std::endl;
                         }
                         catch (const std::invalid_argument& e)
@@ -202,12 +414,12 @@ int main()
                     do 
                     {
                         std::cout << "\n=== Settings Menu ===" << std::endl;
-                        std::cout << "1. Toggle Radian/Degree Mode (Current: " << (calc.settingRadianMode ? "Radian" : "Degree") << ")" << std::endl;
-                        std::cout << "2. Toggle Save History (Current: " << (calc.settingSaveHistory ? "Enabled" : "Disabled") << ")" << std::endl;
-                        std::cout << "3. Set Taylor Series Terms (Current: " << calc.settingTaylorTerms << ")" << std::endl;
-                        std::cout << "4. Set Initial Guess for Interest Rate (Current: " << calc.settingInitialGuessInterest << ")" << std::endl;
-                        std::cout << "5. Set Initial Guess for Number of Periods (Current: " << calc.settingInitialGuessPeriods << ")" << std::endl;
-                        std::cout << "6. Set Error Threshold (Current: " << calc.settingErrorThreshold << ")" << std::endl;
+                        std::cout << "1. Toggle Radian/Degree Mode (Current: " << (calc.getSettings().radianMode ? "Radian" : "Degree") << ")" << std::endl;
+                        std::cout << "2. Toggle Save History (Current: " << (calc.getSettings().saveHistory ? "Enabled" : "Disabled") << ")" << std::endl;
+                        std::cout << "3. Set Taylor Series Terms (Current: " << calc.getSettings().taylorTerms << ")" << std::endl;
+                        std::cout << "4. Set Initial Guess for Interest Rate (Current: " << calc.getSettings().initialGuessInterest << ")" << std::endl;
+                        std::cout << "5. Set Initial Guess for Number of Periods (Current: " << calc.getSettings().initialGuessPeriods << ")" << std::endl;
+                        std::cout << "6. Set Error Threshold (Current: " << calc.getSettings().errorThreshold << ")" << std::endl;
                         std::cout << "0. Return to Main Menu" << std::endl;
 
                         settingsMenuOption = getInteger("Select an option: ");
@@ -215,19 +427,19 @@ int main()
                         switch (settingsMenuOption)
                         {
                             case 1:
-                                calc.settingRadianMode = !calc.settingRadianMode;
-                                std::cout << "Radian/Degree mode toggled to: " << (calc.settingRadianMode ? "Radian" : "Degree") << std::endl;
+                                calc.setRadianMode(!calc.getSettings().radianMode);
+                                std::cout << "Radian/Degree mode toggled to: " << (calc.getSettings().radianMode ? "Radian" : "Degree") << std::endl;
                                 break;
                             case 2:
-                                calc.settingSaveHistory = !calc.settingSaveHistory;
-                                std::cout << "Save History toggled to: " << (calc.settingSaveHistory ? "Enabled" : "Disabled") << std::endl;
+                                calc.setSaveHistory(!calc.getSettings().saveHistory);
+                                std::cout << "Save History toggled to: " << (calc.getSettings().saveHistory ? "Enabled" : "Disabled") << std::endl;
                                 break;
                             case 3:
                             {
                                 int terms = getInteger("Enter the number of Taylor Series terms (minimum 1): ");
                                 if (terms > 0)
                                 {
-                                    calc.settingTaylorTerms = terms;
+                                    calc.setTaylorTerms(terms);
                                     std::cout << "Taylor Series terms set to: " << terms << std::endl;
                                 }
                                 else
@@ -241,7 +453,7 @@ int main()
                                 double initialGuessInterest = getDouble("Enter the initial guess for interest rate calculations (e.g., 0.05 for 5%): ");
                                 if (initialGuessInterest > 0)
                                 {
-                                    calc.settingInitialGuessInterest = initialGuessInterest;
+                                    calc.setInitialGuessInterest(initialGuessInterest);
                                     std::cout << "Initial guess for interest rate set to: " << initialGuessInterest << std::endl;
                                 }
                                 else
@@ -255,7 +467,7 @@ int main()
                                 double initialGuessPeriods = getDouble("Enter the initial guess for number of periods calculations (e.g., 10): ");
                                 if (initialGuessPeriods > 0)
                                 {
-                                    calc.settingInitialGuessPeriods = initialGuessPeriods;
+                                    calc.setInitialGuessPeriods(initialGuessPeriods);
                                     std::cout << "Initial guess for number of periods set to: " << initialGuessPeriods << std::endl;
                                 }
                                 else
@@ -269,7 +481,7 @@ int main()
                                 double errorThreshold = getDouble("Enter the error threshold for calculations (e.g., 0.0000001 or 1.0E-7): ");
                                 if (errorThreshold > 0)
                                 {
-                                    calc.settingErrorThreshold = errorThreshold;
+                                    calc.setErrorThreshold(errorThreshold);
                                     std::cout << "Error threshold set to: " << errorThreshold << std::endl;
                                 }
                                 else